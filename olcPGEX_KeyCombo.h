@@ -2,7 +2,7 @@
 	olcPGEX_KeyCombo.h
 	+-------------------------------------------------------------+
 	|         OneLoneCoder Pixel Game Engine Extension            |
-	|              Basic Key Combo Handling - v1.0                |
+	|              Basic Key Combo Handling - v2.0                |
 	+-------------------------------------------------------------+
 	What is this?
 	~~~~~~~~~~~~~
@@ -47,6 +47,42 @@
 /*
 Versions:
 1.0 - Initial release
+2.0 - Key Combos are indexed by the keys they use, only Key Combos which
+      reference a key that changed state are evaluated each frame
+    - The keyboard is read once per frame into packed bitsets
+    - Modifiers are stored as a KeySet bitmask, any number may be used
+    - Key Combos are stored as parallel arrays with packed state bits
+    - Batch update path evaluating the state machine with SSE2/AVX2
+    - Bulk queries returning the Pressed, Held and Released Key Combos as bitsets
+    - Per frame list of Pressed and Released transitions
+    - Callbacks invoked when a Key Combo is Pressed, Held or Released
+    - Key Sequences such as CTRL-K CTRL-C
+    - Per step time limits for Key Sequences
+    - Key Chords, sets of keys Pressed together in any order
+    - Compile time Key Combo tables with olcPGEX_StaticKeyComboManager
+    - RegisterKeyCombo returns a generational KeyComboHandle, and Key Combos
+      can be removed with UnregisterKeyCombo
+    - RegisterKeyCombos registers many Key Combos in one pass
+    - Identical Key Combos share one slot, every registration of it keeps its
+      own handle and callback
+    - KeyComboDefinition can be hashed, FindKeyCombo looks up a binding in O(1)
+    - Named layers of Key Combos activated through a stack, only the Key Combos
+      in active layers are evaluated
+    - Optional shadowing, the most specific Key Combo Pressed on a frame wins
+      over those using a subset of its Modifiers, with per Key Combo priorities
+    - Keys consumed by Key Combos each frame, and GetKey() which hides them
+    - Exact Key Combos which do not fire while other modifiers are held
+    - Pluggable KeyboardSource, the manager can run without a PGE window
+    - Benchmarks of the manager over synthetic input, enabled with
+      OLC_PGEX_KEY_COMBO_BENCHMARK
+    - Self test checking the SIMD and batch updates against the scalar and
+      indexed ones, enabled with OLC_PGEX_KEY_COMBO_SELF_TEST
+    - KeyComboRecorder writes the keyboard and Key Combo transitions of every
+      frame to a compact binary log from a background thread
+    - ReplayKeyboardSource replays a memory mapped log and verifies the Key
+      Combo transitions against the recording
+    - Simulate runs many frames of keyboard input in one call and returns the
+      transitions of every frame
 */
 
 /*
@@ -62,11 +98,13 @@ the constructor (Key and Modifiers):
 The Key is the final button which triggers the combination.  In CTRL-C
 the Key is C.  ModifierCount is the number of Modifiers which must be in the
 bHeld state.  The constructor should automatically assign this.  Modifiers 
-is an array of olc::Key describing the modifier keys. Modifiers can be *any* 
-key in the system, not just the usual items.  This means that both CTRL-C and 
-A-SPACE are equally valid key combinations.  The first requires CTRL to be 
-held down while C is pressed.  The second requires A to be held down while 
-SPACE is pressed.
+is a KeySet, a bitmask with one bit per olc::Key, describing the modifier keys.
+The order the modifiers are given in does not matter, and there is no limit
+on how many may be used; checking them is a single mask test no matter how
+many there are.  Modifiers can be *any* key in the system, not just the usual
+items.  This means that both CTRL-C and A-SPACE are equally valid key
+combinations.  The first requires CTRL to be held down while C is pressed.
+The second requires A to be held down while SPACE is pressed.
 
 Key Combos behave very similarly to normal olc::Key and they should behave the
 same in nearly all circumstances.  A Key Combo will become Pressed if all Modifier
@@ -78,6 +116,135 @@ the Key Combo was in the Held state on the previous frame.  Basically, they
 work like normal olc::Key and behave as close to the usual expectation for key
 combos as possible.
 
+Internally every registered Key Combo is indexed by each key it references,
+either as the Key or as a Modifier.  Each frame only the Key Combos referencing
+a key which was Pressed or Released, plus those which were Pressed or Released
+on the previous frame, are evaluated.  A Key Combo whose keys did not change
+state cannot change state itself, so thousands of registered Key Combos cost
+very little on frames where nothing happens.  The keyboard itself is read only
+once per frame, into a KeyboardState holding the Held, Pressed and Released
+keys as packed bitsets, and every Key Combo is tested against that snapshot.
+Key Combos are stored as parallel arrays, the Keys and Modifier masks in one
+pair and the Held, Pressed and Released states as one bit per Key Combo, so
+the update only touches tightly packed data.
+
+When a large share of the Key Combos need evaluating in a single frame, for
+example when a commonly used modifier changes state, the manager switches to
+a batch update.  The inputs to every Key Combo are gathered into bitsets and
+the state machine is then run on 64 Key Combos per word, using AVX2 or SSE2
+when the compiler targets them.  Define OLC_PGEX_KEY_COMBO_NO_SIMD to force
+the plain word at a time version.  SetUpdateMode() can force either path;
+both produce identical results.
+
+Rather than calling GetKeyCombo() for every identifier, the state of all Key
+Combos can be read at once with GetPressedKeyCombos(), GetHeldKeyCombos() and
+GetReleasedKeyCombos().  These return a ComboSet, one bit per identifier,
+which can be iterated to visit only the Key Combos in that state:
+
+	for (size_t index : pge_keycombo.GetPressedKeyCombos()) {
+		//The Key Combo in slot index was Pressed this frame
+	}
+
+GetKeyComboEvents() returns the Pressed and Released transitions from the
+last update as a list of KeyComboEvent, ordered by slot index.  A shared slot
+produces one event for each of its registrations, in the order they were
+registered.  The list is reused every frame, so on frames where nothing
+happens it is simply empty.
+
+A callback can also be attached to a Key Combo, either when registering it or
+later with SetKeyComboCallback().  The triggers select which of the Pressed,
+Held and Released states invoke it; it is called at most once per frame with
+the Key Combo's handle and state.  Callbacks are stored in place in a
+KeyComboCallback, which holds up to four pointers worth of captures without
+allocating.  A callback may unregister Key Combos, including its own, and an
+unregistered Key Combo is not called again even later in the same frame.
+Callbacks must not register Key Combos or change callbacks.
+
+	pge_keycombo.RegisterKeyCombo({ olc::Key::S, {olc::Key::CTRL} },
+		[this](olc::keycombo::KeyComboHandle combo, olc::HWButton state) { Save(); });
+
+
+Key Sequences
+
+A Key Sequence is a list of Key Combos which must be Pressed one after the
+other, like CTRL-K CTRL-C, or DOWN, DOWN-RIGHT, RIGHT-Z for a fighting game
+style input.  A step without Modifiers is given as just its Key.
+
+	size_t comment = pge_keycombo.RegisterKeySequence({
+		{ olc::Key::K, {olc::Key::CTRL} },
+		{ olc::Key::C, {olc::Key::CTRL} } });
+
+	if (pge_keycombo.GetKeySequence(comment)) {
+		//The last step was Pressed this frame
+	}
+
+All registered Key Sequences are merged into a single trie of steps.  The
+manager tracks which trie nodes are partially matched and only advances them
+when a key is Pressed, so the cost per frame depends on the number of keys
+Pressed and partial matches, not on the number of Key Sequences.  Pressing
+a key which is not the next step abandons a partial match, except for keys
+used as Modifiers by some step, so CTRL may be released and pressed again
+between CTRL-K and CTRL-C.  A Key Sequence reports completion only for the
+frame its last step is Pressed.
+
+Each step may have a time limit, in seconds, measured from the previous step
+using the fElapsedTime of every frame.  The second argument of the
+KeySequenceDefinition sets the limit for every step, and Timeouts can be
+changed per step afterwards.  A limit of 0 means the step may take as long as
+it likes.  Partial matches which run out of time are dropped through a min
+heap of deadlines, so only the partial matches actually expiring are looked
+at each frame.
+
+	//DOWN, DOWN-RIGHT, RIGHT-Z with each step within 250ms of the last
+	pge_keycombo.RegisterKeySequence({ { olc::Key::DOWN,
+		{ olc::Key::RIGHT, {olc::Key::DOWN} },
+		{ olc::Key::Z, {olc::Key::RIGHT} } }, 0.25f });
+
+
+Key Chords
+
+A Key Chord is a set of keys which must all be Pressed within a short window
+of each other, in any order, such as J and K together.  This cannot be done
+with a Key Combo since a Key Combo needs its Modifiers held before its Key.
+A Key Chord becomes Pressed on the frame its last key is Pressed, provided
+the first of its keys was Pressed no more than the window, in seconds,
+before.  It stays Held while every key is held and is Released as soon as
+any of them is released, just like a Key Combo.
+
+	size_t jk = pge_keycombo.RegisterKeyChord({ {olc::Key::J, olc::Key::K}, 0.05f });
+
+	if (pge_keycombo.GetKeyChord(jk).bPressed) {
+		//J and K were pressed together
+	}
+
+Key Chords are indexed by their keys in the same way as Key Combos, so only
+the Key Chords using a key which was Pressed or Released are looked at.
+
+
+Compile Time Key Combo Tables
+
+A fixed set of Key Combos, such as an application's default bindings, can be
+declared as a constexpr KeyComboTable and given to an
+olcPGEX_StaticKeyComboManager.  Everything about the Key Combos is then
+known to the compiler: nothing is registered at startup, names and enum
+values resolve to constant indices, and for tables of up to 64 entries the
+update is fully unrolled with every Modifier mask a constant.
+
+	enum Binding { Copy, Paste };
+
+	inline constexpr olc::keycombo::KeyComboTable<2> DefaultBindings{ {
+		{ "Copy", { olc::Key::C, {olc::Key::CTRL} } },
+		{ "Paste", { olc::Key::V, {olc::Key::CTRL} } } } };
+
+	using Bindings = olc::keycombo::olcPGEX_StaticKeyComboManager<DefaultBindings>;
+	Bindings bindings;
+
+	bindings.GetKeyCombo<Copy>().bPressed;
+	bindings.GetKeyCombo<Bindings::IndexOf("Paste")>().bPressed;
+
+Like the dynamic manager, passing false to the constructor leaves it unhooked,
+and Update() then evaluates a frame from a KeyboardState passed in directly.
+
 
 Key Combo Manager Integration
 
@@ -87,11 +254,298 @@ define the macro in exactly one place to create the implementation.  Then
 include only the header in any other locations required.
 
 A Key Combo is registered into the system with RegisterKeyCombo.  This
-function also returns the identifier for the Key Combo.  This identifier needs
+function also returns the KeyComboHandle for the Key Combo.  This handle needs
 to be saved to retrieve the Key Combo's state later; it is analogous to the
 olc::Key used in PGE's GetKey() function.  This value should be passed to
 the GeyKeyCombo() function to return the Key Combo's current state.
 
+A Key Combo which is no longer needed is removed with UnregisterKeyCombo.
+Its slot is recycled by a later RegisterKeyCombo, so the manager does not
+grow when bindings come and go.  A KeyComboHandle holds the Index of the
+registration and a Generation which changes every time that registration is
+reused, so a handle to a removed Key Combo is detected and reads as never
+pressed rather than reporting the state of whatever was registered since.
+A default constructed handle refers to nothing.  GetKeyComboSlot() returns
+the slot a handle's Key Combo lives in, which is its bit in the ComboSets
+returned by the bulk queries, and GetKeyComboHandle() turns such a slot back
+into the handle of its first registration.
+
+Registering a Key Combo which is already registered, with the same Key and
+the same Modifiers in any order, does not add a new slot.  The existing slot
+is shared, so CTRL-S registered by three different parts of an application
+is still evaluated once per frame.  Only the state of a shared slot is shared:
+every registration gets its own handle and keeps its own callback, and
+unregistering one leaves the others untouched.  The slot is freed once its
+last registration is removed.
+
+A KeyComboDefinition has a canonical Hash(), built from the Key and the
+Modifier mask so the order Modifiers were listed in does not matter, and
+std::hash is specialized for it.  The manager keeps a hash map from every
+registered definition to its slot, which is how registering a duplicate is
+spotted, and FindKeyCombo() uses the same map to answer "is this combo
+already bound?" in constant time, for example while rebinding keys:
+
+	if (auto existing = pge_keycombo.FindKeyCombo({ olc::Key::S, {olc::Key::CTRL} })) {
+		//CTRL-S is already bound, *existing is the handle of its first registration
+	}
+
+Large sets of bindings are best registered together with RegisterKeyCombos,
+which takes any contiguous container of KeyComboDefinition and returns the
+handles in the same order.  Storage and the key index are sized once for the
+whole batch.
+
+
+Key Combo Layers
+
+Bindings usually depend on what the application is doing: the editor, play
+mode, a text box and a modal dialog each want their own Key Combos.  Every
+Key Combo belongs to a layer, given when it is registered, and only the Key
+Combos in active layers are evaluated.  CreateLayer() makes a named layer,
+or returns the existing one with that name.  Layers are activated by pushing
+them onto a stack which starts with just the default layer.  An exclusive
+layer hides every layer below it, so a modal dialog can take over the
+keyboard and give it back again when it is popped.
+
+	auto editor = pge_keycombo.CreateLayer("editor");
+	auto dialog = pge_keycombo.CreateLayer("dialog");
+	pge_keycombo.RegisterKeyCombo({ olc::Key::S, {olc::Key::CTRL} }, editor);
+	pge_keycombo.RegisterKeyCombo({ olc::Key::ESCAPE }, dialog);
+
+	pge_keycombo.PushLayer(editor);
+	pge_keycombo.PushLayer(dialog, true);	//Only the dialog's Key Combos are active
+	pge_keycombo.PopLayer();				//Back to the default and editor layers
+
+Pushing and popping a layer is constant time, it only records the new top of
+the stack.  The key index is kept per layer and each frame only the indices
+of the active layers are looked at, so an inactive layer costs nothing no
+matter how many Key Combos it holds.  A Key Combo Held when its layer becomes
+inactive is Released on the next frame.  The same definition registered in
+two layers is two separate Key Combos.
+
+A layer only means something to the manager which created it.  PushLayer()
+returns false for a layer the manager does not have, registering into one
+returns an invalid handle and FindKeyCombo() finds nothing in it.
+
+
+Shadowing
+
+Each Key Combo is evaluated on its own, so pressing CTRL-SHIFT-C also presses
+CTRL-C, and C on its own if that is registered too.  SetShadowing(true) adds a
+pass which keeps only the most specific of the Key Combos Pressed on the same
+frame with the same Key.  A Key Combo is shadowed when another one Pressed
+with the same Key has a higher priority, or the same priority and a strict
+superset of its Modifiers.  A shadowed Key Combo is not Pressed at all; it
+produces no event or callback and does not become Held.
+
+	pge_keycombo.SetShadowing(true);
+	auto copy = pge_keycombo.RegisterKeyCombo({ olc::Key::C, {olc::Key::CTRL} });
+	auto copyAll = pge_keycombo.RegisterKeyCombo({ olc::Key::C, {olc::Key::CTRL, olc::Key::SHIFT} });
+	//CTRL-SHIFT-C now only presses copyAll
+
+Priorities default to 0 and are set with SetKeyComboPriority(), so a Key Combo
+can be given a higher priority to keep firing alongside, or instead of, more
+specific ones.  While shadowing is enabled every Key Combo keeps the list of
+Key Combos with the same Key and a strict superset of its Modifiers, worked
+out when it is registered.  Resolving a frame then only looks at the Key
+Combos Pressed that frame and those lists, however many are registered.
+
+
+Exact Key Combos
+
+A Key Combo only asks for its Modifiers to be held, so CTRL-C also fires
+while SHIFT is held.  A definition marked Exact additionally requires every
+other key in the manager's exact modifier set to be up.  The set defaults to
+SHIFT and CTRL and is changed with SetExactModifiers(), for example to add
+keys used as modifiers by the application.  Each Key Combo stores one mask
+of its Modifiers plus the exact modifiers it does not use, so the test is a
+single masked comparison against the keyboard, and an Exact Key Combo is
+indexed under those extra keys as well so holding one Releases it.
+
+	pge_keycombo.RegisterKeyCombo({ olc::Key::C, {olc::Key::CTRL}, true });				//Not with SHIFT
+	pge_keycombo.RegisterKeyCombo({ olc::Key::C, {olc::Key::CTRL, olc::Key::SHIFT}, true });
+
+The Exact flag is part of the definition, so an Exact and a plain CTRL-C are
+two different Key Combos.  The steps of a Key Sequence ignore it, and an
+olcPGEX_StaticKeyComboManager always uses DefaultExactModifiers.
+
+
+Keyboard Sources
+
+By default the manager reads the keyboard from PGE.  SetKeyboardSource()
+replaces that with any KeyboardSource, which returns a whole KeyboardState
+each frame.  ScriptedKeyboardSource plays back frames held in memory, working
+out the Pressed and Released keys from the Held keys of consecutive frames.
+Together with passing false to the constructor, so the manager is not hooked
+into an engine, this runs the manager without a window or graphics context,
+for unit tests, fuzzing and benchmarks, by calling OnBeforeUserUpdate()
+directly.
+
+	olc::keycombo::ScriptedKeyboardSource script;
+	script.PushFrame(olc::keycombo::MakeKeySet({ olc::Key::CTRL }));
+	script.PushFrame(olc::keycombo::MakeKeySet({ olc::Key::CTRL, olc::Key::C }));
+
+	olc::keycombo::olcPGEX_KeyComboManager manager(false);
+	manager.SetKeyboardSource(&script);
+	auto copy = manager.RegisterKeyCombo({ olc::Key::C, {olc::Key::CTRL} });
+
+	float fElapsedTime = 1.0f / 60.0f;
+	while (script.FramesLeft() > 0) {
+		manager.OnBeforeUserUpdate(fElapsedTime);
+	}
+	//manager.GetKeyCombo(copy).bPressed is now true
+
+The manager does not own the source, which must outlive it or be removed by
+passing nullptr, which goes back to reading PGE.
+
+
+Consuming Keys
+
+When CTRL-S saves the level, the plain S which moves the player backwards
+should not also react.  Every frame the manager works out the keys consumed
+by Key Combos: the Key of every Key Combo which is Pressed, Held or Released
+that frame.  Modifiers are not consumed, since CTRL on its own usually means
+nothing.  The manager's GetKey() works just like PGE's, except that a
+consumed key reads as untouched, so switching OnUserUpdate, or another PGEX,
+from GetKey() to pge_keycombo.GetKey() is all it takes.
+
+	if (pge_keycombo.GetKey(olc::Key::S).bHeld) {
+		//S is held, and not as part of CTRL-S
+	}
+
+GetConsumedKeys() returns the whole KeySet and IsKeyConsumed() tests a
+single key, both a single bit test.  The set is kept up to date from the
+Pressed and Released transitions, with a count per key of the Held Key
+Combos using it, so it costs nothing on frames where nothing happens.
+
+
+Benchmarks
+
+Defining OLC_PGEX_KEY_COMBO_BENCHMARK along with the implementation adds
+RunKeyComboBenchmark() and RunKeyComboBenchmarkSuite().  A benchmark
+registers a number of random Key Combos, each with the same number of
+Modifiers, builds the input for every frame up front in a
+ScriptedKeyboardSource and then times only the updates of a manager which
+is not hooked into any engine.  The activity picks how busy the keyboard is:
+Idle never changes a key, Typing taps a key every few frames with the
+occasional modifier, and Mashing changes several keys and modifiers every
+frame.  The result gives the time per frame and per Key Combo.  The suite
+runs a matrix of Key Combo counts, Modifier counts and activities and
+prints a table, so a build of this program is all it takes to compare
+changes to the update:
+
+	#define OLC_PGEX_KEY_COMBO_IMPLEMENTATION
+	#define OLC_PGEX_KEY_COMBO_BENCHMARK
+	#include "olcPGEX_KeyCombo.h"
+	#include <iostream>
+
+	int main() {
+		olc::keycombo::RunKeyComboBenchmarkSuite(std::cout);
+	}
+
+Key Combos with the same definition share a slot, so a benchmark asking for
+more Key Combos than there are distinct definitions, which happens quickly
+with few Modifiers, reports how many slots were actually used.
+
+
+Self Test
+
+Defining OLC_PGEX_KEY_COMBO_SELF_TEST along with the implementation adds
+RunKeyComboSelfTest(), which checks that every update path gives the same
+results.  It first runs the word at a time state machine used by the batch
+update over random words and compares it bit for bit with the plain scalar
+version.  It then drives three unhooked managers, forced to the Indexed and
+Batch paths and left on Auto, with the same random Key Combos and input,
+pushing and popping layers, registering and unregistering Key Combos one at
+a time and in batches which repeat existing definitions, changing the exact
+modifiers and, in some rounds, shadowing.  Every frame the events and the
+Pressed, Held and Released sets of the three must match.  It writes any
+differences to out and returns how many there were.
+
+	#define OLC_PGEX_KEY_COMBO_IMPLEMENTATION
+	#define OLC_PGEX_KEY_COMBO_SELF_TEST
+	#include "olcPGEX_KeyCombo.h"
+	#include <iostream>
+
+	int main() {
+		return olc::keycombo::RunKeyComboSelfTest(std::cout) == 0 ? 0 : 1;
+	}
+
+The SIMD path is picked when compiling, so build this once for each: with
+-mavx2 for AVX2, with the default flags for SSE2 on x86-64, and with
+OLC_PGEX_KEY_COMBO_NO_SIMD defined for the plain version.
+
+
+Recording Input
+
+A KeyComboRecorder given to SetRecorder() captures, for every frame, the
+KeyboardState the manager read, the fElapsedTime and the Key Combo
+transitions which resulted, for example to record QA sessions and reproduce
+bugs later.  Frames are delta encoded, so only keys whose state changed are
+stored, and an idle frame with the same fElapsedTime as the one before takes
+a single byte.  The encoded frames are collected in memory and handed to a
+background thread in large blocks, so recording never waits on the disk.
+
+	olc::keycombo::KeyComboRecorder recorder;
+	if (recorder.Open("session.okcl")) {
+		pge_keycombo.SetRecorder(&recorder);
+	}
+
+The log starts with the 4 bytes "OKCL", a version byte and the number of keys
+as a varint, followed by one record per frame:
+	flags byte: 1 = fElapsedTime changed, 2 = keys changed, 4 = transitions
+	fElapsedTime as a 32 bit little endian float, if it changed
+	if keys changed, a varint count then per key a varint of key << 3 with
+	    the new Pressed, Released and Held state in the low 3 bits
+	if there were transitions, a varint count then per transition a varint
+	    of the handle Index << 1, plus 1 if it was Released
+Varints are little endian base 128.  Every key starts untouched.
+
+A ReplayKeyboardSource plays a log back.  The file is memory mapped and each
+frame is decoded straight from the mapping as it is read, so nothing is
+copied and logs of any length open instantly.  Set up a manager with the same
+Key Combos, registered in the same order, as the one which was recorded, and
+ReplayInto() runs every frame through it as fast as it can, passing the
+recorded fElapsedTime and comparing the transitions of each frame with the
+recorded ones.  It returns the number of frames which differed, so a
+regression suite is a loop over the logs checking for 0.
+
+	olc::keycombo::ReplayKeyboardSource replay;
+	olc::keycombo::olcPGEX_KeyComboManager manager(false);
+	RegisterBindings(manager);
+	if (replay.Open("session.okcl") && replay.ReplayInto(manager) > 0) {
+		//Frame replay.GetFirstMismatch() behaved differently
+	}
+
+The replay can also be stepped by hand: set it as the manager's keyboard
+source, pass NextElapsedTime() to OnBeforeUserUpdate() and check the result
+with VerifyEvents().
+
+
+Simulation
+
+Tests rarely need a keyboard source at all.  Update() evaluates one frame
+from a KeyboardState passed in directly, and Simulate() runs a whole array of
+frames in one call, returning a KeyComboSimulation with the transitions of
+every frame stored back to back.  The frames can be full KeyboardStates, or
+just the held keys of each frame, in which case Pressed and Released are
+worked out from the frame before.  Neither touches PGE, so with the
+manager constructed unhooked the state machine is effectively a function
+from input arrays to a transition stream.
+
+	olc::keycombo::olcPGEX_KeyComboManager manager(false);
+	auto copy = manager.RegisterKeyCombo({ olc::Key::C, {olc::Key::CTRL} });
+
+	std::vector<olc::keycombo::KeySet> frames = {
+		olc::keycombo::MakeKeySet({ olc::Key::CTRL }),
+		olc::keycombo::MakeKeySet({ olc::Key::CTRL, olc::Key::C }),
+		olc::keycombo::MakeKeySet({}) };
+
+	auto result = manager.Simulate(frames);
+	//result.GetFrameEvents(1) holds copy Pressed, result.GetFrameEvents(2) copy Released
+
+Passing the same KeyComboSimulation back in reuses its storage, so long runs
+do not allocate.
+
 
 Basic Integration Example
 
@@ -103,7 +557,7 @@ Basic Integration Example
 class Example : public olc::PixelGameEngine
 {
 	olc::keycombo::KeyComboManager pge_keycombo;
-	size_t ctrl_c_combo;
+	olc::keycombo::KeyComboHandle ctrl_c_combo;
 
 public:
 	Example()
@@ -149,100 +603,2956 @@ public:
 #include "olcPixelGameEngine.h"
 #include <array>
 #include <algorithm>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(OLC_PGEX_KEY_COMBO_BENCHMARK) || defined(OLC_PGEX_KEY_COMBO_SELF_TEST)
+#include <chrono>
+#include <cstdio>
+#include <ostream>
+#include <random>
+#endif
+
+#if !defined(OLC_PGEX_KEY_COMBO_NO_SIMD)
+#if defined(__AVX2__)
+#define OLC_PGEX_KEY_COMBO_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OLC_PGEX_KEY_COMBO_SSE2
+#include <emmintrin.h>
+#endif
+#endif
 
 namespace olc {
 	namespace keycombo {
+		//Index of the lowest set bit.  v must not be 0.
+		inline int CountTrailingZeros(uint64_t v) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+			unsigned long i;
+			_BitScanForward64(&i, v);
+			return int(i);
+#elif defined(_MSC_VER)
+			unsigned long i;
+			if (_BitScanForward(&i, uint32_t(v))) {
+				return int(i);
+			}
+			_BitScanForward(&i, uint32_t(v >> 32));
+			return int(i) + 32;
+#else
+			return __builtin_ctzll(v);
+#endif
+		}
+
+		//Number of set bits
+		inline int PopCount(uint64_t v) {
+#if defined(_MSC_VER) && defined(_M_X64)
+			return int(__popcnt64(v));
+#elif defined(_MSC_VER)
+			return int(__popcnt(uint32_t(v)) + __popcnt(uint32_t(v >> 32)));
+#else
+			return __builtin_popcountll(v);
+#endif
+		}
+
+		//Fixed size bitset with one bit for every olc::Key
+		struct KeySet {
+			static constexpr size_t WordCount = (olc::Key::ENUM_END + 63) / 64;
+			std::array<uint64_t, WordCount> Words{};
+
+			constexpr void Set(olc::Key k, bool value = true) {
+				Words[k / 64] = (Words[k / 64] & ~(uint64_t(1) << (k % 64))) | (uint64_t(value) << (k % 64));
+			}
+
+			constexpr bool Test(olc::Key k) const {
+				return (Words[k / 64] >> (k % 64)) & 1;
+			}
+
+			//True if every key in sub is also in this set
+			constexpr bool Contains(const KeySet& sub) const {
+				uint64_t missing = 0;
+				for (size_t i = 0; i < WordCount; i++) missing |= sub.Words[i] & ~Words[i];
+				return missing == 0;
+			}
+
+			constexpr bool Any() const {
+				for (auto w : Words) {
+					if (w) return true;
+				}
+				return false;
+			}
+
+			//Keys in this set but not in rhs
+			constexpr KeySet Without(const KeySet& rhs) const {
+				KeySet r;
+				for (size_t i = 0; i < WordCount; i++) r.Words[i] = Words[i] & ~rhs.Words[i];
+				return r;
+			}
+
+			constexpr KeySet operator&(const KeySet& rhs) const {
+				KeySet r;
+				for (size_t i = 0; i < WordCount; i++) r.Words[i] = Words[i] & rhs.Words[i];
+				return r;
+			}
+
+			constexpr KeySet operator|(const KeySet& rhs) const {
+				KeySet r;
+				for (size_t i = 0; i < WordCount; i++) r.Words[i] = Words[i] | rhs.Words[i];
+				return r;
+			}
+
+			constexpr bool operator==(const KeySet& rhs) const {
+				for (size_t i = 0; i < WordCount; i++) {
+					if (Words[i] != rhs.Words[i]) return false;
+				}
+				return true;
+			}
+
+			constexpr bool operator!=(const KeySet& rhs) const {
+				return !(*this == rhs);
+			}
+
+			constexpr uint64_t Hash() const {
+				uint64_t hash = 0;
+				for (auto w : Words) {
+					hash = (hash ^ w) * 0xBF58476D1CE4E5B9ull;
+					hash ^= hash >> 31;
+				}
+				return hash;
+			}
+
+			//Call f(olc::Key) for every key in the set, in ascending order
+			template<typename F>
+			void ForEach(F f) const {
+				for (size_t i = 0; i < WordCount; i++) {
+					for (uint64_t w = Words[i]; w; w &= w - 1) {
+						f(olc::Key(i * 64 + CountTrailingZeros(w)));
+					}
+				}
+			}
+		};
+
+		//KeySet holding every key in keys
+		constexpr KeySet MakeKeySet(std::initializer_list<olc::Key> keys) {
+			KeySet set;
+			for (auto k : keys) set.Set(k);
+			return set;
+		}
+
+		//Keys an Exact key combo does not allow to be held, unless it uses them
+		inline constexpr KeySet DefaultExactModifiers = MakeKeySet({ olc::Key::SHIFT, olc::Key::CTRL });
+
+		//Snapshot of the whole keyboard, taken once per frame
+		struct KeyboardState {
+			KeySet Held;
+			KeySet Pressed;
+			KeySet Released;
+		};
+
+		//Read every key of the engine exactly once
+		inline KeyboardState ReadKeyboardState(const olc::PixelGameEngine* engine) {
+			KeyboardState keyboard;
+			for (int k = 0; k < olc::Key::ENUM_END; k++) {
+				olc::HWButton keyState = engine->GetKey(olc::Key(k));
+				keyboard.Held.Words[k / 64] |= uint64_t(keyState.bHeld) << (k % 64);
+				keyboard.Pressed.Words[k / 64] |= uint64_t(keyState.bPressed) << (k % 64);
+				keyboard.Released.Words[k / 64] |= uint64_t(keyState.bReleased) << (k % 64);
+			}
+			return keyboard;
+		}
+
+		//Provides the state of the whole keyboard once per frame
+		class KeyboardSource {
+		public:
+			virtual ~KeyboardSource() = default;
+
+			//Keyboard state for the frame about to be evaluated
+			virtual KeyboardState Read() = 0;
+		};
+
+		//Reads the keys of a PixelGameEngine, as the manager does by default
+		class PGEKeyboardSource : public KeyboardSource {
+		public:
+			explicit PGEKeyboardSource(const olc::PixelGameEngine* engine) : Engine(engine) {}
+
+			KeyboardState Read() override {
+				return ReadKeyboardState(Engine);
+			}
+
+		private:
+			const olc::PixelGameEngine* Engine;
+		};
+
+		//Plays back a list of frames kept in memory.  Once every frame has been read the
+		//last frame's keys stay held, with nothing Pressed or Released.
+		class ScriptedKeyboardSource : public KeyboardSource {
+		public:
+			//Add a frame with these keys held.  Pressed and Released come from the
+			//difference to the previous frame.
+			void PushFrame(const KeySet& held) {
+				KeyboardState frame;
+				frame.Held = held;
+				frame.Pressed = held.Without(LastHeld);
+				frame.Released = LastHeld.Without(held);
+				Frames.push_back(frame);
+				LastHeld = held;
+			}
+
+			//Add a frame exactly as given
+			void PushFrame(const KeyboardState& frame) {
+				Frames.push_back(frame);
+				LastHeld = frame.Held;
+			}
+
+			size_t FramesLeft() const {
+				return Frames.size() - Position;
+			}
+
+			//Start playing back from the first frame again
+			void Rewind() {
+				Position = 0;
+			}
+
+			void Clear() {
+				Frames.clear();
+				Position = 0;
+				LastHeld = {};
+			}
+
+			KeyboardState Read() override {
+				if (Position < Frames.size()) {
+					return Frames[Position++];
+				}
+				KeyboardState idle;
+				idle.Held = Frames.empty() ? KeySet{} : Frames.back().Held;
+				return idle;
+			}
+
+		private:
+			std::vector<KeyboardState> Frames;
+			size_t Position = 0;
+			KeySet LastHeld;
+		};
+
 		//Structure which defines what a key combination actually is
 		struct KeyComboDefinition {
 			//The main key which triggers the changes in KeyCombo state
 			olc::Key Key;
 
-			//Number of modifier keys which must be held to trigger the KeyCombo
-			int ModifierCount;
+			//Number of distinct modifier keys which must be held to trigger the KeyCombo
+			int ModifierCount = 0;
+
+			//Actual modifier keys, one bit per olc::Key
+			KeySet Modifiers;
+
+			//If set, no other key of the manager's exact modifier set may be held
+			bool Exact = false;
 
-			//Actual modifier keys
-			std::array<olc::Key, 4> Modifiers;
+			//Key with no modifiers, used for the steps of a KeySequenceDefinition
+			constexpr KeyComboDefinition(olc::Key MainKey, bool ExactMods = false) : Key(MainKey), Exact(ExactMods) {}
 
 			//ty slavka for the brain power
 			template<typename T, size_t NumMods>
-			KeyComboDefinition(olc::Key MainKey, const T(&Mods)[NumMods]) {
-				static_assert(NumMods <= 4); // use a named constant for better error messages
-				Key = MainKey;
-				ModifierCount = NumMods;
-				std::copy(std::begin(Mods), std::end(Mods), std::begin(Modifiers));
+			constexpr KeyComboDefinition(olc::Key MainKey, const T(&Mods)[NumMods], bool ExactMods = false) : Key(MainKey), Exact(ExactMods) {
+				for (size_t i = 0; i < NumMods; i++) {
+					if (!Modifiers.Test(Mods[i])) {
+						Modifiers.Set(Mods[i]);
+						ModifierCount++;
+					}
+				}
+			}
+
+			//Two definitions are the same combo if they have the same Key, Modifiers and Exact flag
+			constexpr bool operator==(const KeyComboDefinition& rhs) const {
+				return Key == rhs.Key && Modifiers == rhs.Modifiers && Exact == rhs.Exact;
+			}
+
+			constexpr bool operator!=(const KeyComboDefinition& rhs) const {
+				return !(*this == rhs);
 			}
 
+			//Same for any two definitions which compare equal, whatever order the Modifiers were given in
+			constexpr uint64_t Hash() const {
+				uint64_t hash = (Modifiers.Hash() ^ uint64_t(Key) ^ (uint64_t(Exact) << 32)) * 0x9E3779B97F4A7C15ull;
+				return hash ^ (hash >> 32);
+			}
 		};
 
-		struct KeyCombo {
-			KeyComboDefinition Definition;
-			olc::HWButton State;
-			bool StateOld = false;
-			bool StateNew = false;
+		//Hash function object for containers of KeyComboDefinition
+		struct KeyComboDefinitionHash {
+			size_t operator()(const KeyComboDefinition& def) const {
+				return size_t(def.Hash());
+			}
 		};
 
-		class olcPGEX_KeyComboManager : public olc::PGEX {
-		public:
+		//Set of keys which must all be pressed within Window seconds, in any order
+		struct KeyChordDefinition {
+			KeySet Keys;
+			float Window = 0.05f;
 
-			olcPGEX_KeyComboManager();
+			template<typename T, size_t NumKeys>
+			constexpr KeyChordDefinition(const T(&ChordKeys)[NumKeys], float ChordWindow = 0.05f) : Window(ChordWindow) {
+				for (size_t i = 0; i < NumKeys; i++) {
+					Keys.Set(ChordKeys[i]);
+				}
+			}
+		};
 
-			size_t RegisterKeyCombo(const KeyComboDefinition def);
+		//A list of key combos which must be pressed one after the other
+		struct KeySequenceDefinition {
+			std::vector<KeyComboDefinition> Steps;
 
-			//Automatically run prior to OnUserUpdate and will determine the state of every registered key combo
-			void OnBeforeUserUpdate(float& fElapsedTime) override;
+			//Seconds allowed between the previous step and each step, 0 for no limit.
+			//The limit of the first step is unused.
+			std::vector<float> Timeouts;
 
-			HWButton GetKeyCombo(const int i) const;
-		
-		private:
-			std::vector<KeyCombo> KeyCombos;
+			KeySequenceDefinition(std::initializer_list<KeyComboDefinition> steps, float stepTimeout = 0.0f)
+				: Steps(steps), Timeouts(steps.size(), stepTimeout) {}
 		};
-	}
-}
 
-#ifdef OLC_PGEX_KEY_COMBO_IMPLEMENTATION
-namespace olc::keycombo {
-	//Passing true to PGEX() will add this into the PGE hooks to be run automatically
-	olcPGEX_KeyComboManager::olcPGEX_KeyComboManager() : PGEX(true) {};
+		//Growable bitset with one bit per registered key combo
+		struct ComboSet {
+			std::vector<uint64_t> Words;
 
-	size_t olcPGEX_KeyComboManager::RegisterKeyCombo(const KeyComboDefinition def) {
-		KeyCombos.push_back({ def , {} });
-		return KeyCombos.size() - 1;
-	}
+			//Iterates over the indices of the set bits, in ascending order
+			class Iterator {
+			public:
+				using iterator_category = std::forward_iterator_tag;
+				using value_type = size_t;
+				using difference_type = std::ptrdiff_t;
+				using pointer = const size_t*;
+				using reference = size_t;
 
-	HWButton olcPGEX_KeyComboManager::GetKeyCombo(const int i) const {
-		return KeyCombos[i].State;
-	}
+				Iterator(const uint64_t* words, size_t word, size_t count) : Words(words), Word(word), Count(count) {
+					Bits = Word < Count ? Words[Word] : 0;
+					Skip();
+				}
 
-	void olcPGEX_KeyComboManager::OnBeforeUserUpdate(float& fElapsedTime) {
-		for (auto& kc : KeyCombos) {
-			bool mods_held = std::all_of(kc.Definition.Modifiers.begin(),
-				kc.Definition.Modifiers.begin() + kc.Definition.ModifierCount,
-				[](auto k) {return pge->GetKey(k).bHeld; });
+				size_t operator*() const {
+					return Word * 64 + CountTrailingZeros(Bits);
+				}
 
-			kc.State.bPressed = false;
-			kc.State.bReleased = false;
+				Iterator& operator++() {
+					Bits &= Bits - 1;
+					Skip();
+					return *this;
+				}
 
-			olc::HWButton keyState = pge->GetKey(kc.Definition.Key);
+				bool operator==(const Iterator& rhs) const {
+					return Word == rhs.Word && Bits == rhs.Bits;
+				}
 
-			//The combo will become active if all the modifiers are held down and the Key is Pressed
-			//or all the modifiers are held down the the combo is already held
-			kc.StateNew = mods_held && (keyState.bPressed || (kc.State.bHeld && keyState.bHeld));
+				bool operator!=(const Iterator& rhs) const {
+					return !(*this == rhs);
+				}
 
-			//This is just the same logic as in PGE today for normal key presses.
-			if (kc.StateNew != kc.StateOld) {
-				if (kc.StateNew) {
-					kc.State.bPressed = !kc.State.bHeld;
-					kc.State.bHeld = true;
+			private:
+				//Move to the next word with any bits set
+				void Skip() {
+					while (!Bits && Word < Count) {
+						if (++Word < Count) Bits = Words[Word];
+					}
 				}
-				else {
-					kc.State.bReleased = true;
-					kc.State.bHeld = false;
+
+				const uint64_t* Words;
+				size_t Word;
+				size_t Count;
+				uint64_t Bits = 0;
+			};
+
+			Iterator begin() const {
+				return Iterator(Words.data(), 0, Words.size());
+			}
+
+			Iterator end() const {
+				return Iterator(Words.data(), Words.size(), Words.size());
+			}
+
+			//Make room for at least count bits, the set never shrinks
+			void Resize(size_t count) {
+				if ((count + 63) / 64 > Words.size()) {
+					Words.resize((count + 63) / 64, 0);
 				}
 			}
 
-			kc.StateOld = kc.StateNew;
-		}
-	}
+			bool Test(size_t i) const {
+				return (Words[i / 64] >> (i % 64)) & 1;
+			}
+
+			void Set(size_t i, bool value = true) {
+				Words[i / 64] = (Words[i / 64] & ~(uint64_t(1) << (i % 64))) | (uint64_t(value) << (i % 64));
+			}
+
+			bool Any() const {
+				for (auto w : Words) {
+					if (w) return true;
+				}
+				return false;
+			}
+
+			//Number of set bits
+			size_t Count() const {
+				size_t n = 0;
+				for (auto w : Words) n += PopCount(w);
+				return n;
+			}
+		};
+
+		//Callable wrapper which stores its target in place, so it never allocates.
+		//The target must fit within Capacity bytes.
+		template<typename Signature, size_t Capacity = 4 * sizeof(void*)>
+		class InplaceFunction;
+
+		template<typename R, typename... Args, size_t Capacity>
+		class InplaceFunction<R(Args...), Capacity> {
+		public:
+			InplaceFunction() = default;
+
+			template<typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, InplaceFunction>>>
+			InplaceFunction(F&& f) {
+				using T = std::decay_t<F>;
+				static_assert(sizeof(T) <= Capacity, "Callable is too large for this InplaceFunction");
+				static_assert(alignof(T) <= alignof(std::max_align_t), "Callable is over aligned");
+				new (Storage) T(std::forward<F>(f));
+				Invoke = [](void* target, Args... args) -> R {
+					return (*static_cast<T*>(target))(std::forward<Args>(args)...);
+				};
+				Manage = [](Operation op, void* dst, void* src) {
+					switch (op) {
+					case Operation::Copy: new (dst) T(*static_cast<const T*>(src)); break;
+					case Operation::Move: new (dst) T(std::move(*static_cast<T*>(src))); break;
+					case Operation::Destroy: static_cast<T*>(dst)->~T(); break;
+					}
+				};
+			}
+
+			InplaceFunction(const InplaceFunction& rhs) {
+				Assign(rhs, Operation::Copy);
+			}
+
+			InplaceFunction(InplaceFunction&& rhs) noexcept {
+				Assign(rhs, Operation::Move);
+			}
+
+			InplaceFunction& operator=(const InplaceFunction& rhs) {
+				if (this != &rhs) {
+					Reset();
+					Assign(rhs, Operation::Copy);
+				}
+				return *this;
+			}
+
+			InplaceFunction& operator=(InplaceFunction&& rhs) noexcept {
+				if (this != &rhs) {
+					Reset();
+					Assign(rhs, Operation::Move);
+				}
+				return *this;
+			}
+
+			~InplaceFunction() {
+				Reset();
+			}
+
+			explicit operator bool() const {
+				return Invoke != nullptr;
+			}
+
+			R operator()(Args... args) const {
+				return Invoke(const_cast<unsigned char*>(Storage), std::forward<Args>(args)...);
+			}
+
+		private:
+			enum class Operation { Copy, Move, Destroy };
+
+			void Assign(const InplaceFunction& rhs, Operation op) {
+				if (rhs.Manage) {
+					rhs.Manage(op, Storage, const_cast<unsigned char*>(rhs.Storage));
+				}
+				Invoke = rhs.Invoke;
+				Manage = rhs.Manage;
+			}
+
+			void Reset() {
+				if (Manage) {
+					Manage(Operation::Destroy, Storage, nullptr);
+				}
+				Invoke = nullptr;
+				Manage = nullptr;
+			}
+
+			alignas(std::max_align_t) unsigned char Storage[Capacity];
+			R(*Invoke)(void*, Args...) = nullptr;
+			void(*Manage)(Operation, void*, void*) = nullptr;
+		};
+
+		//Identifies a registration of a key combo.  Index is the registration, Generation
+		//changes every time that registration is reused so stale handles can be detected.
+		//A default constructed handle is never valid.
+		struct KeyComboHandle {
+			uint32_t Index = UINT32_MAX;
+			uint32_t Generation = 0;
+
+			bool operator==(const KeyComboHandle& rhs) const {
+				return Index == rhs.Index && Generation == rhs.Generation;
+			}
+
+			bool operator!=(const KeyComboHandle& rhs) const {
+				return !(*this == rhs);
+			}
+		};
+
+		//Identifies a layer of key combos.  Layer 0 is the default layer.
+		struct KeyComboLayer {
+			uint32_t Index = 0;
+
+			bool operator==(const KeyComboLayer& rhs) const {
+				return Index == rhs.Index;
+			}
+
+			bool operator!=(const KeyComboLayer& rhs) const {
+				return !(*this == rhs);
+			}
+		};
+
+		//Called with the handle and state of a key combo
+		using KeyComboCallback = InplaceFunction<void(KeyComboHandle, olc::HWButton)>;
+
+		//Which key combo states invoke its callback, may be combined
+		enum KeyComboTrigger : uint8_t {
+			TriggerPressed = 1,
+			TriggerHeld = 2,
+			TriggerReleased = 4
+		};
+
+		//Edge a key combo went through during an update
+		enum class KeyComboTransition : uint8_t {
+			Pressed,
+			Released
+		};
+
+		struct KeyComboEvent {
+			KeyComboHandle Handle;
+			KeyComboTransition Transition;
+		};
+
+		//How OnBeforeUserUpdate decides which combos to evaluate
+		enum class UpdateMode {
+			//Pick per frame based on how many combos need evaluating
+			Auto,
+			//Only evaluate the combos whose keys changed state
+			Indexed,
+			//Evaluate every combo with the batched bit logic
+			Batch
+		};
+
+		//Writes every frame seen by a manager to a delta encoded binary log.  Encoding
+		//happens on the calling thread, writing the file on a background thread.
+		class KeyComboRecorder {
+		public:
+			KeyComboRecorder() = default;
+			~KeyComboRecorder();
+
+			KeyComboRecorder(const KeyComboRecorder&) = delete;
+			KeyComboRecorder& operator=(const KeyComboRecorder&) = delete;
+
+			//Start a new log at path, returns false if the file cannot be created
+			bool Open(const std::string& path);
+
+			//Write everything recorded so far and close the log
+			void Close();
+
+			bool IsOpen() const;
+
+			//Append one frame to the log
+			void RecordFrame(const KeyboardState& keyboard, float fElapsedTime, const std::vector<KeyComboEvent>& events);
+
+		private:
+			//Hand the current block to the writer thread
+			void Submit();
+
+			//Body of the writer thread
+			void WriteBlocks();
+
+			//Size at which a block is handed to the writer thread
+			static constexpr size_t BlockSize = 64 * 1024;
+
+			std::ofstream File;
+			std::thread Writer;
+			std::mutex Lock;
+			std::condition_variable Wake;
+			std::vector<std::vector<uint8_t>> Blocks;
+			bool Stopping = false;
+
+			//Block being filled, and the state the next frame is encoded against
+			std::vector<uint8_t> Block;
+			KeyboardState Previous;
+			uint32_t PreviousElapsed = 0;
+		};
+
+		class olcPGEX_KeyComboManager;
+
+		//Plays back a log written by a KeyComboRecorder, decoding each frame directly
+		//from a read only memory mapping of the file
+		class ReplayKeyboardSource : public KeyboardSource {
+		public:
+			ReplayKeyboardSource() = default;
+			~ReplayKeyboardSource();
+
+			ReplayKeyboardSource(const ReplayKeyboardSource&) = delete;
+			ReplayKeyboardSource& operator=(const ReplayKeyboardSource&) = delete;
+
+			//Map the log at path, returns false if it cannot be read or is not a log
+			bool Open(const std::string& path);
+
+			//Replay a log already in memory, which must outlive its use
+			bool Open(const uint8_t* data, size_t size);
+
+			void Close();
+
+			//True once every frame has been read
+			bool AtEnd() const;
+
+			//Recorded fElapsedTime of the frame Read() returns next
+			float NextElapsedTime() const;
+
+			//Number of frames read so far
+			size_t GetFrame() const;
+
+			KeyboardState Read() override;
+
+			//True if events match the transitions recorded for the frame last read
+			bool VerifyEvents(const std::vector<KeyComboEvent>& events) const;
+
+			//Run every remaining frame through manager, making this its keyboard source.
+			//Returns the number of frames whose transitions differ from the recording.
+			size_t ReplayInto(olcPGEX_KeyComboManager& manager);
+
+			//First frame which differed in ReplayInto, or SIZE_MAX if none did
+			size_t GetFirstMismatch() const;
+
+		private:
+			//Decode a varint at pos, false if the log ends first
+			bool ReadVarint(size_t& pos, uint64_t& v) const;
+
+			//Skip to the end of a log which turned out to be truncated
+			void Truncated();
+
+			const uint8_t* Data = nullptr;
+			size_t Size = 0;
+			size_t Position = 0;
+
+			//State built up from the frames read so far
+			KeyboardState Current;
+			uint32_t Elapsed = 0;
+			size_t Frame = 0;
+			size_t FirstMismatch = SIZE_MAX;
+
+			//Where the transitions of the frame last read start, SIZE_MAX if it had none
+			size_t EventsPosition = SIZE_MAX;
+
+			//The mapping, if the log was opened from a file
+			void* Mapping = nullptr;
+			size_t MappingSize = 0;
+#if defined(_WIN32)
+			void* FileHandle = nullptr;
+			void* MappingHandle = nullptr;
+#endif
+		};
+
+		//Transitions of every frame of a simulation, stored back to back.  The events of
+		//frame f are Events[FrameStart[f]] up to Events[FrameStart[f + 1]].
+		struct KeyComboSimulation {
+			std::vector<KeyComboEvent> Events;
+			std::vector<size_t> FrameStart{ 0 };
+
+			size_t FrameCount() const {
+				return FrameStart.size() - 1;
+			}
+
+			//Pointer to the first event of frame f and the number of events it had
+			std::pair<const KeyComboEvent*, size_t> GetFrameEvents(size_t f) const {
+				return { Events.data() + FrameStart[f], FrameStart[f + 1] - FrameStart[f] };
+			}
+
+			void Clear() {
+				Events.clear();
+				FrameStart.assign(1, 0);
+			}
+		};
+
+		class olcPGEX_KeyComboManager : public olc::PGEX {
+		public:
+
+			//Pass false to use the manager without hooking it into a PixelGameEngine,
+			//calling OnBeforeUserUpdate yourself
+			olcPGEX_KeyComboManager(bool bHook = true);
+
+			//Read the keyboard from source instead of PGE, nullptr goes back to PGE.
+			//The source is not owned and must outlive its use.
+			void SetKeyboardSource(KeyboardSource* source);
+
+			//Record every frame into recorder, nullptr stops recording.  The recorder is
+			//not owned and must outlive its use.
+			void SetRecorder(KeyComboRecorder* recorder);
+
+			//Register a key combo in layer, returning an invalid handle if there is no such layer
+			KeyComboHandle RegisterKeyCombo(const KeyComboDefinition def, KeyComboLayer layer = {});
+
+			//Register every definition in defs, returning their handles in the same order.
+			//Every handle is invalid if there is no such layer.
+			std::vector<KeyComboHandle> RegisterKeyCombos(const KeyComboDefinition* defs, size_t count, KeyComboLayer layer = {});
+
+			template<typename Container>
+			std::vector<KeyComboHandle> RegisterKeyCombos(const Container& defs, KeyComboLayer layer = {}) {
+				return RegisterKeyCombos(std::data(defs), std::size(defs), layer);
+			}
+
+			//Handle of the first registration of def in layer, if there is one
+			std::optional<KeyComboHandle> FindKeyCombo(const KeyComboDefinition& def, KeyComboLayer layer = {}) const;
+
+			//Create a named layer, or return the existing layer with that name
+			KeyComboLayer CreateLayer(std::string_view name);
+
+			//Layer called name, if there is one
+			std::optional<KeyComboLayer> FindLayer(std::string_view name) const;
+
+			//True if layer was created by this manager
+			bool IsValid(KeyComboLayer layer) const;
+
+			//Activate a layer on top of the stack.  An exclusive layer deactivates every
+			//layer below it until it is popped.  Returns false if there is no such layer.
+			bool PushLayer(KeyComboLayer layer, bool exclusive = false);
+
+			//Deactivate the layer on top of the stack.  Returns false if only the
+			//default layer is left.
+			bool PopLayer();
+
+			//True if the key combos in layer are being evaluated
+			bool IsLayerActive(KeyComboLayer layer) const;
+
+			//When enabled, a key combo is not pressed if a more specific or higher priority
+			//key combo with the same Key is pressed on the same frame
+			void SetShadowing(bool enabled);
+
+			//Priority used by shadowing, higher priorities shadow lower ones
+			void SetKeyComboPriority(KeyComboHandle handle, int priority);
+
+			//Keys which Exact key combos require to be up unless they use them
+			void SetExactModifiers(const KeySet& modifiers);
+
+			//Keys used as the Key of a key combo which is Pressed, Held or Released this frame
+			const KeySet& GetConsumedKeys() const;
+
+			bool IsKeyConsumed(olc::Key k) const;
+
+			//State of a key for this frame as PGE reports it, unless a key combo consumed it
+			HWButton GetKey(olc::Key k) const;
+
+			//Remove a registration of a key combo.  Its slot can be reused once every
+			//registration of it is removed.  Returns false for a stale handle.
+			bool UnregisterKeyCombo(KeyComboHandle handle);
+
+			//True if handle refers to a key combo which is still registered
+			bool IsValid(KeyComboHandle handle) const;
+
+			//Slot of the key combo handle refers to, or SIZE_MAX for a stale handle
+			size_t GetKeyComboSlot(KeyComboHandle handle) const;
+
+			//Handle of the first registration of the key combo currently in slot index,
+			//or an invalid handle if the slot is unused
+			KeyComboHandle GetKeyComboHandle(size_t index) const;
+
+			//Register a key sequence, returning its identifier
+			size_t RegisterKeySequence(const KeySequenceDefinition& def);
+
+			//True on the frame the last step of the key sequence is pressed
+			bool GetKeySequence(size_t id) const;
+
+			//Every key sequence completed this frame, one bit per identifier
+			const ComboSet& GetCompletedKeySequences() const;
+
+			//Register a key chord, returning its identifier
+			size_t RegisterKeyChord(const KeyChordDefinition def);
+
+			HWButton GetKeyChord(size_t id) const;
+
+			//Register a key combo and attach a callback to it
+			KeyComboHandle RegisterKeyCombo(const KeyComboDefinition def, KeyComboCallback callback, uint8_t triggers = TriggerPressed, KeyComboLayer layer = {});
+
+			//Replace the callback attached to a key combo, an empty callback removes it
+			void SetKeyComboCallback(KeyComboHandle handle, KeyComboCallback callback, uint8_t triggers = TriggerPressed);
+
+			//Automatically run prior to OnUserUpdate and will determine the state of every registered key combo
+			void OnBeforeUserUpdate(float& fElapsedTime) override;
+
+			//Evaluate one frame with keyboard as the state of every key
+			void Update(const KeyboardState& keyboard, float fElapsedTime);
+
+			//Evaluate count frames in order, appending the transitions of each to result
+			void Simulate(const KeyboardState* frames, size_t count, KeyComboSimulation& result, float fElapsedTime = 1.0f / 60.0f);
+
+			//As above, with only the held keys of each frame given.  Pressed and Released
+			//come from the difference to the frame before.
+			void Simulate(const KeySet* held, size_t count, KeyComboSimulation& result, float fElapsedTime = 1.0f / 60.0f);
+
+			//Evaluate every frame of a contiguous container of KeyboardState or KeySet
+			template<typename Container>
+			KeyComboSimulation Simulate(const Container& frames, float fElapsedTime = 1.0f / 60.0f) {
+				KeyComboSimulation result;
+				Simulate(std::data(frames), std::size(frames), result, fElapsedTime);
+				return result;
+			}
+
+			//State of a key combo, a stale handle reads as never pressed
+			HWButton GetKeyCombo(KeyComboHandle handle) const;
+
+			//State of the key combo in slot i
+			HWButton GetKeyCombo(const int i) const;
+
+			//State of every key combo at once, one bit per slot
+			const ComboSet& GetPressedKeyCombos() const;
+			const ComboSet& GetHeldKeyCombos() const;
+			const ComboSet& GetReleasedKeyCombos() const;
+
+			//Every Pressed and Released transition from the last update, ordered by slot
+			//and then by registration
+			const std::vector<KeyComboEvent>& GetKeyComboEvents() const;
+
+			//Force a particular update path, mostly useful for testing and benchmarking
+			void SetUpdateMode(UpdateMode mode);
+		
+		private:
+			//Evaluate a single key combo against the current keyboard state
+			void UpdateKeyCombo(size_t i);
+
+			//Evaluate every key combo using the batched bit logic
+			void UpdateAllKeyCombos();
+
+			//Evaluate only the pending combos and those using a key in changed
+			void UpdateQueuedKeyCombos(const KeySet& changed);
+
+			//Invoke the callbacks of every combo whose state matches its triggers
+			void DispatchCallbacks();
+
+			//Advance the partial key sequence matches on the keys pressed this frame
+			void UpdateKeySequences();
+
+			//Evaluate the key chords using a key which changed state this frame
+			void UpdateKeyChords(const KeySet& changed);
+
+			//Add a key combo to the list of combos to evaluate this frame
+			void QueueKeyCombo(size_t i);
+
+			//Remove every mention of slot i from a list of slots
+			static void RemoveSlot(std::vector<size_t>& slots, size_t i);
+
+			//Take a free slot, or add a new one, and store def in it.  The slot is not
+			//added to the key index and has no registrations yet.
+			size_t AllocateKeyComboSlot(const KeyComboDefinition& def, uint32_t layer);
+
+			//Add a registration to the end of slot i's list, returning its handle
+			KeyComboHandle AddRegistration(size_t i);
+
+			//Add slot i to the key index under every key it uses
+			void IndexKeyComboSlot(size_t i);
+
+			//Slot already holding def in layer, or SIZE_MAX if there is none
+			size_t FindKeyComboSlot(const KeyComboDefinition& def, uint32_t layer) const;
+
+			//Recompute which layers are active after the layer stack changed
+			void UpdateActiveLayers();
+
+			//Keys whose held state is compared for slot i, its Modifiers plus for an
+			//Exact combo the exact modifiers it does not use
+			KeySet ModifierMask(size_t i) const;
+
+			//Record which key combos with the same Key shadow slot i, and which it shadows,
+			//looking only at the slots below limit
+			void LinkShadowing(size_t i, size_t limit = SIZE_MAX);
+
+			//Drop the key combos shadowed by another key combo pressed this frame
+			void ResolveShadowing();
+
+			//Definition of every combo, split into parallel arrays indexed by slot.
+			//An unused slot has the Key NONE and no Modifiers, so it is never pressed.
+			std::vector<olc::Key> ComboKeys;
+			std::vector<KeySet> ComboModifiers;
+			std::vector<uint32_t> ComboLayers;
+			std::vector<uint8_t> ComboExact;
+
+			//Result of ModifierMask for every combo.  The combo's modifiers are held exactly
+			//when the held keys masked by this equal its Modifiers.
+			std::vector<KeySet> ComboMasks;
+
+			KeySet ExactModifiers = DefaultExactModifiers;
+			bool ExactModifiersChanged = false;
+
+			//A registered definition along with the layer it was registered in
+			struct SlotKey {
+				KeyComboDefinition Definition;
+				uint32_t Layer;
+
+				bool operator==(const SlotKey& rhs) const {
+					return Definition == rhs.Definition && Layer == rhs.Layer;
+				}
+			};
+
+			struct SlotKeyHash {
+				size_t operator()(const SlotKey& key) const {
+					return size_t(key.Definition.Hash() ^ (uint64_t(key.Layer) * 0x9E3779B97F4A7C15ull));
+				}
+			};
+
+			//Slot of every registered definition
+			std::unordered_map<SlotKey, uint32_t, SlotKeyHash> SlotLookup;
+
+			//Which slots are in use and the slots free for reuse.  The registrations of
+			//each slot form a list running from its First to its Last registration.
+			ComboSet Live;
+			std::vector<uint32_t> FreeSlots;
+			std::vector<uint32_t> FirstRegistrations;
+			std::vector<uint32_t> LastRegistrations;
+
+			//Slot of every registration, UINT32_MAX once it is removed, the next
+			//registration of the same slot, and the registrations free for reuse.
+			//Generation changes every time a registration is removed.
+			std::vector<uint32_t> RegistrationSlots;
+			std::vector<uint32_t> NextRegistrations;
+			std::vector<uint32_t> Generations;
+			std::vector<uint32_t> FreeRegistrations;
+
+			//Current state of every combo, one bit each.  Held is also the state
+			//the combo was in on the previous frame.
+			ComboSet Held;
+			ComboSet Pressed;
+			ComboSet Released;
+
+			//Set while the combo is in the list of combos to evaluate this frame
+			ComboSet Queued;
+
+			//State of every key for the current frame, and where it is read from
+			KeyboardState Keyboard;
+			KeyboardSource* Source = nullptr;
+
+			KeyComboRecorder* Recorder = nullptr;
+
+			//Total of every fElapsedTime, the clock all timeouts are measured with
+			double Clock = 0.0;
+
+			//Time every key was last pressed
+			std::array<double, olc::Key::ENUM_END> KeyPressedTime{};
+
+			//For every layer and key, the combos in that layer which use the key as
+			//either the Key or a Modifier
+			std::vector<std::array<std::vector<size_t>, olc::Key::ENUM_END>> KeyIndex{ 1 };
+
+			//Name of every layer
+			std::vector<std::string> LayerNames{ "default" };
+
+			//Stack of pushed layers.  Base is the position of the lowest active entry,
+			//so the active layers are always LayerStack[top.Base] up to the top.
+			struct LayerStackEntry {
+				uint32_t Layer;
+				uint32_t Base;
+			};
+
+			std::vector<LayerStackEntry> LayerStack{ { 0, 0 } };
+
+			//Whether each layer is active, brought up to date at the start of the
+			//frame after the stack changed
+			std::vector<uint8_t> LayerActive{ 1 };
+			bool LayersChanged = false;
+
+			//Priority of every combo, and while shadowing is enabled the combos with the
+			//same Key and a strict superset of its Modifiers
+			std::vector<int> Priorities;
+			std::vector<std::vector<size_t>> ShadowedBy;
+			bool Shadowing = false;
+
+			//Highest priority pressed this frame for each Key, and the combos shadowed
+			std::array<int, olc::Key::ENUM_END> ShadowPriority{};
+			std::vector<size_t> Shadowed;
+
+			//Number of Held combos using each key as their Key, the keys with at least
+			//one, and those plus the keys of combos Released this frame
+			std::array<uint32_t, olc::Key::ENUM_END> HeldKeyCombos{};
+			KeySet HeldComboKeys;
+			KeySet ConsumedKeys;
+
+			//Combos which were Pressed or Released last frame and must be cleared
+			std::vector<size_t> PendingCombos;
+
+			//Scratch list of the combos to evaluate this frame, kept to avoid reallocating
+			std::vector<size_t> DirtyCombos;
+
+			//Transitions produced by the last update
+			std::vector<KeyComboEvent> Events;
+
+			//Callback of every registration, and the states which invoke it
+			std::vector<KeyComboCallback> Callbacks;
+			std::vector<uint8_t> CallbackTriggers;
+
+			//Registrations of held combos with a TriggerHeld callback, invoked every frame
+			std::vector<size_t> HeldCallbacks;
+
+			//True while callbacks are being invoked.  Registrations removed by a callback
+			//keep their callback until dispatch finishes, as it may be the one running.
+			bool Dispatching = false;
+			std::vector<uint32_t> RetiredRegistrations;
+
+			//Node of the trie all key sequences are compiled into.  Node 0 is the root,
+			//every other node is reached by pressing its step.
+			struct SequenceNode {
+				KeySet Modifiers;
+				//Seconds allowed since the previous step to reach this node, 0 for no limit
+				float Timeout = 0.0f;
+				//Longest Timeout of any child, 0 if any child has no limit
+				float Window = 0.0f;
+				std::vector<size_t> Completes;
+				uint32_t ChildCount = 0;
+			};
+
+			std::vector<SequenceNode> SequenceNodes{ 1 };
+
+			//Children of each node by the key of their step, keyed by (node << 32) | key
+			std::unordered_map<uint64_t, std::vector<uint32_t>> SequenceEdges;
+
+			//Keys used as modifiers by any step, pressing these does not abandon a partial match
+			KeySet SequenceModifierKeys;
+
+			//Partially matched nodes, and scratch space for the next set along with
+			//the time each next node was reached
+			std::vector<uint32_t> SequenceActive;
+			std::vector<uint32_t> SequenceNext;
+			std::vector<double> SequenceNextReached;
+
+			//Time each node was reached while it is partially matched, negative otherwise
+			std::vector<double> SequenceReached{ -1.0 };
+
+			//Frame stamp per node to avoid adding a node to SequenceNext twice, and
+			//where in SequenceNext it was added
+			std::vector<uint32_t> SequenceStamp{ 0 };
+			std::vector<uint32_t> SequenceSlot{ 0 };
+			uint32_t SequenceFrame = 0;
+
+
+			//Time a partial match runs out unless it advances
+			struct SequenceDeadline {
+				double Deadline;
+				double Reached;
+				uint32_t Node;
+
+				bool operator>(const SequenceDeadline& rhs) const {
+					return Deadline > rhs.Deadline;
+				}
+			};
+
+			std::priority_queue<SequenceDeadline, std::vector<SequenceDeadline>, std::greater<SequenceDeadline>> SequenceDeadlines;
+
+			//Definition and state of every key chord, indexed by chord id
+			std::vector<KeySet> ChordKeys;
+			std::vector<float> ChordWindows;
+			ComboSet ChordHeld;
+			ComboSet ChordPressed;
+			ComboSet ChordReleased;
+
+			//For every key, the chords which use it
+			std::array<std::vector<size_t>, olc::Key::ENUM_END> ChordIndex;
+
+			//Chords which were Pressed or Released this frame and must be cleared
+			std::vector<size_t> ChordPending;
+
+			//Sequences completed this frame, as a bitset and as a list for clearing it
+			size_t SequenceCount = 0;
+			ComboSet SequencesCompleted;
+			std::vector<size_t> SequencesCompletedList;
+
+			//Scratch inputs for the batch update, one bit per combo
+			ComboSet BatchModsHeld;
+			ComboSet BatchKeyPressed;
+			ComboSet BatchKeyHeld;
+
+			UpdateMode Mode = UpdateMode::Auto;
+		};
+
+		//One named entry of a compile time key combo table
+		struct KeyComboTableEntry {
+			std::string_view Name;
+			KeyComboDefinition Definition;
+		};
+
+		template<size_t N>
+		using KeyComboTable = std::array<KeyComboTableEntry, N>;
+
+		//Key combo manager specialized on a constexpr KeyComboTable.  The table is fixed
+		//at compile time, so there is no registration and every lookup is a constant.
+		template<const auto& Table>
+		class olcPGEX_StaticKeyComboManager : public olc::PGEX {
+		public:
+			static constexpr size_t Count = std::tuple_size_v<std::decay_t<decltype(Table)>>;
+
+			//Pass false to use the manager without hooking it into a PixelGameEngine,
+			//calling Update yourself
+			olcPGEX_StaticKeyComboManager(bool bHook = true) : PGEX(bHook) {}
+
+			//Index of the entry called name, or Count if there is none
+			static constexpr size_t IndexOf(std::string_view name) {
+				for (size_t i = 0; i < Count; i++) {
+					if (Table[i].Name == name) return i;
+				}
+				return Count;
+			}
+
+			//State of the entry at I, which may be an index or an enum value
+			template<auto I>
+			HWButton GetKeyCombo() const {
+				static_assert(size_t(I) < Count, "No such entry in the key combo table");
+				return States[size_t(I)];
+			}
+
+			HWButton GetKeyCombo(size_t i) const {
+				return States[i];
+			}
+
+			void OnBeforeUserUpdate(float& /*fElapsedTime*/) override {
+				Update(ReadKeyboardState(pge));
+			}
+
+			//Evaluate one frame with keyboard as the state of every key
+			void Update(const KeyboardState& keyboard) {
+				Keyboard = keyboard;
+
+				if constexpr (Count <= 64) {
+					UpdateAll(std::make_index_sequence<Count>{});
+				}
+				else {
+					for (size_t i = 0; i < Count; i++) {
+						UpdateEntry(i, Table[i].Definition);
+					}
+				}
+			}
+
+		private:
+			template<size_t... I>
+			void UpdateAll(std::index_sequence<I...>) {
+				(UpdateEntry(I, Table[I].Definition), ...);
+			}
+
+			//Same logic as olcPGEX_KeyComboManager, with the definition a constant when unrolled.
+			//Exact entries use DefaultExactModifiers.
+			void UpdateEntry(size_t i, const KeyComboDefinition& def) {
+				bool held = States[i].bHeld;
+				KeySet mask = def.Exact ? def.Modifiers | DefaultExactModifiers.Without(MakeKeySet({ def.Key })) : def.Modifiers;
+				bool state = (Keyboard.Held & mask) == def.Modifiers && (Keyboard.Pressed.Test(def.Key) ||
+					(held && Keyboard.Held.Test(def.Key)));
+
+				States[i].bPressed = state && !held;
+				States[i].bReleased = !state && held;
+				States[i].bHeld = state;
+			}
+
+			KeyboardState Keyboard;
+			std::array<HWButton, Count> States{};
+		};
+	}
+}
+
+namespace std {
+	template<>
+	struct hash<olc::keycombo::KeyComboDefinition> : olc::keycombo::KeyComboDefinitionHash {};
+}
+
+#ifdef OLC_PGEX_KEY_COMBO_BENCHMARK
+namespace olc::keycombo {
+	//How busy the keyboard is during a benchmark
+	enum class BenchmarkActivity {
+		Idle,
+		Typing,
+		Mashing
+	};
+
+	struct KeyComboBenchmarkParams {
+		size_t Combos = 1000;
+		//Modifiers of every key combo, at most 12
+		int Modifiers = 1;
+		BenchmarkActivity Activity = BenchmarkActivity::Typing;
+		size_t Frames = 20000;
+		UpdateMode Mode = UpdateMode::Auto;
+		uint32_t Seed = 1;
+	};
+
+	struct KeyComboBenchmarkResult {
+		KeyComboBenchmarkParams Params;
+		//Slots in use, fewer than Params.Combos when definitions repeat
+		size_t Slots = 0;
+		double NsPerFrame = 0.0;
+		double NsPerCombo = 0.0;
+		//Pressed and Released transitions over the whole run
+		size_t Events = 0;
+	};
+
+	//Time a manager updating Params.Frames frames of synthetic input
+	KeyComboBenchmarkResult RunKeyComboBenchmark(const KeyComboBenchmarkParams& params);
+
+	//Run every combination of several combo counts, modifier counts and activities,
+	//writing a table of the results to out
+	void RunKeyComboBenchmarkSuite(std::ostream& out, UpdateMode mode = UpdateMode::Auto);
+}
+#endif
+
+#ifdef OLC_PGEX_KEY_COMBO_SELF_TEST
+namespace olc::keycombo {
+	//Check the SIMD and batch updates against the scalar and indexed ones on random
+	//input, writing every difference to out.  Returns the number of differences.
+	size_t RunKeyComboSelfTest(std::ostream& out, uint32_t seed = 1);
+}
+#endif
+
+#ifdef OLC_PGEX_KEY_COMBO_IMPLEMENTATION
+#if defined(_WIN32)
+#if !defined(NOMINMAX)
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace olc::keycombo {
+	//Passing true to PGEX() will add this into the PGE hooks to be run automatically,
+	//false leaves the manager free of any engine
+	olcPGEX_KeyComboManager::olcPGEX_KeyComboManager(bool bHook) : PGEX(bHook) {};
+
+	void olcPGEX_KeyComboManager::SetKeyboardSource(KeyboardSource* source) {
+		Source = source;
+	}
+
+	void olcPGEX_KeyComboManager::SetRecorder(KeyComboRecorder* recorder) {
+		Recorder = recorder;
+	}
+
+	size_t olcPGEX_KeyComboManager::AllocateKeyComboSlot(const KeyComboDefinition& def, uint32_t layer) {
+		size_t id;
+		if (!FreeSlots.empty()) {
+			id = FreeSlots.back();
+			FreeSlots.pop_back();
+			ComboKeys[id] = def.Key;
+			ComboModifiers[id] = def.Modifiers;
+			ComboLayers[id] = layer;
+			ComboExact[id] = def.Exact;
+			Priorities[id] = 0;
+		}
+		else {
+			id = ComboKeys.size();
+			ComboKeys.push_back(def.Key);
+			ComboModifiers.push_back(def.Modifiers);
+			ComboLayers.push_back(layer);
+			ComboExact.push_back(def.Exact);
+			ComboMasks.emplace_back();
+			Priorities.push_back(0);
+			ShadowedBy.emplace_back();
+			FirstRegistrations.push_back(UINT32_MAX);
+			LastRegistrations.push_back(UINT32_MAX);
+
+			Held.Resize(id + 1);
+			Pressed.Resize(id + 1);
+			Released.Resize(id + 1);
+			Queued.Resize(id + 1);
+			Live.Resize(id + 1);
+		}
+		ComboMasks[id] = ModifierMask(id);
+		Live.Set(id);
+		SlotLookup.emplace(SlotKey{ def, layer }, uint32_t(id));
+		return id;
+	}
+
+	KeyComboHandle olcPGEX_KeyComboManager::AddRegistration(size_t id) {
+		uint32_t r;
+		if (!FreeRegistrations.empty()) {
+			r = FreeRegistrations.back();
+			FreeRegistrations.pop_back();
+		}
+		else {
+			r = uint32_t(RegistrationSlots.size());
+			RegistrationSlots.push_back(UINT32_MAX);
+			NextRegistrations.push_back(UINT32_MAX);
+			Generations.push_back(0);
+			Callbacks.emplace_back();
+			CallbackTriggers.push_back(0);
+		}
+		RegistrationSlots[r] = uint32_t(id);
+		NextRegistrations[r] = UINT32_MAX;
+
+		if (LastRegistrations[id] == UINT32_MAX) {
+			FirstRegistrations[id] = r;
+		}
+		else {
+			NextRegistrations[LastRegistrations[id]] = r;
+		}
+		LastRegistrations[id] = r;
+		return { r, Generations[r] };
+	}
+
+	KeySet olcPGEX_KeyComboManager::ModifierMask(size_t id) const {
+		if (!ComboExact[id]) {
+			return ComboModifiers[id];
+		}
+
+		KeySet key;
+		key.Set(ComboKeys[id]);
+		return ComboModifiers[id] | ExactModifiers.Without(key);
+	}
+
+	void olcPGEX_KeyComboManager::IndexKeyComboSlot(size_t id) {
+		//The Key may also be one of the Modifiers, but it only needs one entry in the index.
+		//An Exact combo is also indexed under the exact modifiers it does not use.
+		auto& keyIndex = KeyIndex[ComboLayers[id]];
+		auto index = [&](olc::Key k) {
+			if (keyIndex[k].empty() || keyIndex[k].back() != id) {
+				keyIndex[k].push_back(id);
+			}
+		};
+
+		index(ComboKeys[id]);
+		ComboMasks[id].ForEach(index);
+
+		if (Shadowing) {
+			LinkShadowing(id);
+		}
+	}
+
+	void olcPGEX_KeyComboManager::LinkShadowing(size_t id, size_t limit) {
+		//Every combo with the same Key, in any layer, is in that layer's index under the Key
+		olc::Key key = ComboKeys[id];
+		for (auto& keyIndex : KeyIndex) {
+			for (auto j : keyIndex[key]) {
+				if (j == id || j >= limit || ComboKeys[j] != key || ComboModifiers[j] == ComboModifiers[id]) continue;
+
+				if (ComboModifiers[j].Contains(ComboModifiers[id])) {
+					ShadowedBy[id].push_back(j);
+				}
+				else if (ComboModifiers[id].Contains(ComboModifiers[j])) {
+					ShadowedBy[j].push_back(id);
+				}
+			}
+		}
+	}
+
+	size_t olcPGEX_KeyComboManager::FindKeyComboSlot(const KeyComboDefinition& def, uint32_t layer) const {
+		auto found = SlotLookup.find(SlotKey{ def, layer });
+		return found != SlotLookup.end() ? found->second : SIZE_MAX;
+	}
+
+	KeyComboHandle olcPGEX_KeyComboManager::RegisterKeyCombo(const KeyComboDefinition def, KeyComboLayer layer) {
+		if (!IsValid(layer)) {
+			return {};
+		}
+
+		size_t id = FindKeyComboSlot(def, layer.Index);
+		if (id == SIZE_MAX) {
+			id = AllocateKeyComboSlot(def, layer.Index);
+			IndexKeyComboSlot(id);
+		}
+		return AddRegistration(id);
+	}
+
+	std::vector<KeyComboHandle> olcPGEX_KeyComboManager::RegisterKeyCombos(const KeyComboDefinition* defs, size_t count, KeyComboLayer layer) {
+		std::vector<KeyComboHandle> handles(count);
+		if (!IsValid(layer)) {
+			return handles;
+		}
+
+		//Find the first occurrence of every definition with an open addressed hash table
+		//of indices into defs, so identical definitions are found in a single pass.
+		//A first occurrence may already be registered from before this batch, in which
+		//case its slot is remembered and only the others need new slots.
+		size_t tableSize = 16;
+		while (tableSize < count * 2) tableSize *= 2;
+		std::vector<uint32_t> table(tableSize, UINT32_MAX);
+		std::vector<uint32_t> first(count);
+		std::vector<size_t> existing(count, SIZE_MAX);
+
+		size_t unique = 0;
+		for (size_t i = 0; i < count; i++) {
+			size_t slot = size_t(defs[i].Hash()) & (tableSize - 1);
+			while (table[slot] != UINT32_MAX && defs[table[slot]] != defs[i]) {
+				slot = (slot + 1) & (tableSize - 1);
+			}
+			if (table[slot] == UINT32_MAX) {
+				table[slot] = uint32_t(i);
+				existing[i] = FindKeyComboSlot(defs[i], layer.Index);
+				if (existing[i] == SIZE_MAX) {
+					unique++;
+				}
+			}
+			first[i] = table[slot];
+		}
+
+		//Grow all the storage once for the whole batch
+		size_t added = unique > FreeSlots.size() ? unique - FreeSlots.size() : 0;
+		size_t total = ComboKeys.size() + added;
+		ComboKeys.reserve(total);
+		ComboModifiers.reserve(total);
+		ComboLayers.reserve(total);
+		ComboExact.reserve(total);
+		ComboMasks.reserve(total);
+		Priorities.reserve(total);
+		ShadowedBy.reserve(total);
+		FirstRegistrations.reserve(total);
+		LastRegistrations.reserve(total);
+		for (auto set : { &Held, &Pressed, &Released, &Queued, &Live }) {
+			set->Resize(total);
+		}
+		SlotLookup.reserve(SlotLookup.size() + unique);
+
+		size_t registrations = RegistrationSlots.size() + (count > FreeRegistrations.size() ? count - FreeRegistrations.size() : 0);
+		RegistrationSlots.reserve(registrations);
+		NextRegistrations.reserve(registrations);
+		Generations.reserve(registrations);
+		Callbacks.reserve(registrations);
+		CallbackTriggers.reserve(registrations);
+
+		std::vector<size_t> slots;
+		slots.reserve(unique);
+		for (size_t i = 0; i < count; i++) {
+			size_t id;
+			if (first[i] == i) {
+				id = existing[i];
+				if (id == SIZE_MAX) {
+					id = AllocateKeyComboSlot(defs[i], layer.Index);
+					slots.push_back(id);
+				}
+			}
+			else {
+				id = RegistrationSlots[handles[first[i]].Index];
+			}
+			handles[i] = AddRegistration(id);
+		}
+
+		//Size every list in the layer's key index once, then fill them
+		std::array<size_t, olc::Key::ENUM_END> keyCounts{};
+		for (auto id : slots) {
+			ComboMasks[id].ForEach([&](olc::Key k) { keyCounts[k]++; });
+			if (!ComboMasks[id].Test(ComboKeys[id])) keyCounts[ComboKeys[id]]++;
+		}
+		auto& keyIndex = KeyIndex[layer.Index];
+		for (int k = 0; k < olc::Key::ENUM_END; k++) {
+			keyIndex[k].reserve(keyIndex[k].size() + keyCounts[k]);
+		}
+		for (auto id : slots) {
+			IndexKeyComboSlot(id);
+		}
+
+		return handles;
+	}
+
+	KeyComboHandle olcPGEX_KeyComboManager::RegisterKeyCombo(const KeyComboDefinition def, KeyComboCallback callback, uint8_t triggers, KeyComboLayer layer) {
+		KeyComboHandle handle = RegisterKeyCombo(def, layer);
+		SetKeyComboCallback(handle, std::move(callback), triggers);
+		return handle;
+	}
+
+	void olcPGEX_KeyComboManager::RemoveSlot(std::vector<size_t>& slots, size_t i) {
+		auto found = std::find(slots.begin(), slots.end(), i);
+		if (found != slots.end()) {
+			*found = slots.back();
+			slots.pop_back();
+		}
+	}
+
+	bool olcPGEX_KeyComboManager::UnregisterKeyCombo(KeyComboHandle handle) {
+		if (!IsValid(handle)) {
+			return false;
+		}
+
+		uint32_t r = handle.Index;
+		if (Dispatching) {
+			CallbackTriggers[r] = 0;
+			RetiredRegistrations.push_back(r);
+		}
+		else {
+			SetKeyComboCallback(handle, {});
+			FreeRegistrations.push_back(r);
+		}
+
+		//Unlink the registration from its slot's list
+		size_t id = RegistrationSlots[r];
+		uint32_t previous = UINT32_MAX;
+		uint32_t* link = &FirstRegistrations[id];
+		while (*link != r) {
+			previous = *link;
+			link = &NextRegistrations[previous];
+		}
+		*link = NextRegistrations[r];
+		if (LastRegistrations[id] == r) {
+			LastRegistrations[id] = previous;
+		}
+
+		RegistrationSlots[r] = UINT32_MAX;
+		Generations[r]++;
+
+		if (FirstRegistrations[id] != UINT32_MAX) {
+			return true;
+		}
+
+		KeyComboDefinition def(ComboKeys[id], ComboExact[id]);
+		def.Modifiers = ComboModifiers[id];
+		SlotLookup.erase(SlotKey{ def, ComboLayers[id] });
+
+		auto& keyIndex = KeyIndex[ComboLayers[id]];
+		RemoveSlot(keyIndex[ComboKeys[id]], id);
+		ComboMasks[id].ForEach([&](olc::Key k) { RemoveSlot(keyIndex[k], id); });
+
+		if (Shadowing) {
+			for (auto& index : KeyIndex) {
+				for (auto j : index[ComboKeys[id]]) {
+					RemoveSlot(ShadowedBy[j], id);
+				}
+			}
+			ShadowedBy[id].clear();
+		}
+
+		//The pending list must stay sorted, so this one is not swapped out of place
+		PendingCombos.erase(std::remove(PendingCombos.begin(), PendingCombos.end(), id), PendingCombos.end());
+
+		if (Held.Test(id) && --HeldKeyCombos[ComboKeys[id]] == 0) {
+			HeldComboKeys.Set(ComboKeys[id], false);
+		}
+
+		ComboKeys[id] = olc::Key::NONE;
+		ComboModifiers[id] = {};
+		ComboMasks[id] = {};
+		ComboExact[id] = false;
+		Held.Set(id, false);
+		Pressed.Set(id, false);
+		Released.Set(id, false);
+		Live.Set(id, false);
+
+		FreeSlots.push_back(uint32_t(id));
+		return true;
+	}
+
+	bool olcPGEX_KeyComboManager::IsValid(KeyComboHandle handle) const {
+		return handle.Index < Generations.size() && Generations[handle.Index] == handle.Generation && RegistrationSlots[handle.Index] != UINT32_MAX;
+	}
+
+	size_t olcPGEX_KeyComboManager::GetKeyComboSlot(KeyComboHandle handle) const {
+		return IsValid(handle) ? RegistrationSlots[handle.Index] : SIZE_MAX;
+	}
+
+	std::optional<KeyComboHandle> olcPGEX_KeyComboManager::FindKeyCombo(const KeyComboDefinition& def, KeyComboLayer layer) const {
+		if (!IsValid(layer)) {
+			return std::nullopt;
+		}
+
+		size_t id = FindKeyComboSlot(def, layer.Index);
+		if (id == SIZE_MAX) {
+			return std::nullopt;
+		}
+		return GetKeyComboHandle(id);
+	}
+
+	KeyComboLayer olcPGEX_KeyComboManager::CreateLayer(std::string_view name) {
+		if (auto existing = FindLayer(name)) {
+			return *existing;
+		}
+
+		LayerNames.emplace_back(name);
+		KeyIndex.emplace_back();
+		LayerActive.push_back(0);
+		return { uint32_t(LayerNames.size() - 1) };
+	}
+
+	std::optional<KeyComboLayer> olcPGEX_KeyComboManager::FindLayer(std::string_view name) const {
+		for (size_t i = 0; i < LayerNames.size(); i++) {
+			if (LayerNames[i] == name) {
+				return KeyComboLayer{ uint32_t(i) };
+			}
+		}
+		return std::nullopt;
+	}
+
+	bool olcPGEX_KeyComboManager::IsValid(KeyComboLayer layer) const {
+		return layer.Index < LayerNames.size();
+	}
+
+	bool olcPGEX_KeyComboManager::PushLayer(KeyComboLayer layer, bool exclusive) {
+		if (!IsValid(layer)) {
+			return false;
+		}
+
+		uint32_t top = uint32_t(LayerStack.size());
+		LayerStack.push_back({ layer.Index, exclusive ? top : LayerStack.back().Base });
+		LayersChanged = true;
+		return true;
+	}
+
+	bool olcPGEX_KeyComboManager::PopLayer() {
+		if (LayerStack.size() == 1) {
+			return false;
+		}
+		LayerStack.pop_back();
+		LayersChanged = true;
+		return true;
+	}
+
+	bool olcPGEX_KeyComboManager::IsLayerActive(KeyComboLayer layer) const {
+		for (size_t i = LayerStack.back().Base; i < LayerStack.size(); i++) {
+			if (LayerStack[i].Layer == layer.Index) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void olcPGEX_KeyComboManager::SetShadowing(bool enabled) {
+		if (enabled == Shadowing) {
+			return;
+		}
+
+		Shadowing = enabled;
+		for (auto& shadows : ShadowedBy) {
+			shadows.clear();
+		}
+
+		//Link every registered combo, each pair is found once by whichever slot comes later
+		if (Shadowing) {
+			for (auto i : Live) {
+				LinkShadowing(i, i);
+			}
+		}
+	}
+
+	void olcPGEX_KeyComboManager::SetKeyComboPriority(KeyComboHandle handle, int priority) {
+		if (IsValid(handle)) {
+			Priorities[RegistrationSlots[handle.Index]] = priority;
+		}
+	}
+
+	void olcPGEX_KeyComboManager::ResolveShadowing() {
+		//Highest priority pressed for each Key
+		for (auto i : PendingCombos) {
+			if (Pressed.Test(i)) {
+				ShadowPriority[ComboKeys[i]] = INT_MIN;
+			}
+		}
+		for (auto i : PendingCombos) {
+			if (Pressed.Test(i)) {
+				ShadowPriority[ComboKeys[i]] = std::max(ShadowPriority[ComboKeys[i]], Priorities[i]);
+			}
+		}
+
+		//Shadowing is transitive, so checking against every pressed combo, shadowed or not,
+		//gives the same result as checking against only the winners
+		Shadowed.clear();
+		for (auto i : PendingCombos) {
+			if (!Pressed.Test(i)) continue;
+
+			bool shadowed = Priorities[i] < ShadowPriority[ComboKeys[i]];
+			for (size_t n = 0; !shadowed && n < ShadowedBy[i].size(); n++) {
+				size_t j = ShadowedBy[i][n];
+				shadowed = Pressed.Test(j) && Priorities[j] >= Priorities[i];
+			}
+			if (shadowed) {
+				Shadowed.push_back(i);
+			}
+		}
+
+		if (Shadowed.empty()) {
+			return;
+		}
+
+		for (auto i : Shadowed) {
+			Pressed.Set(i, false);
+			Held.Set(i, false);
+		}
+		PendingCombos.erase(std::remove_if(PendingCombos.begin(), PendingCombos.end(),
+			[&](size_t i) { return !Pressed.Test(i) && !Released.Test(i); }), PendingCombos.end());
+	}
+
+	void olcPGEX_KeyComboManager::SetExactModifiers(const KeySet& modifiers) {
+		ExactModifiers = modifiers;
+
+		//Move every Exact combo in the key index from its old extra keys to the new ones
+		for (auto id : Live) {
+			if (!ComboExact[id]) continue;
+
+			auto& keyIndex = KeyIndex[ComboLayers[id]];
+			ComboMasks[id].Without(ComboModifiers[id]).ForEach([&](olc::Key k) { RemoveSlot(keyIndex[k], id); });
+			ComboMasks[id] = ModifierMask(id);
+			ComboMasks[id].Without(ComboModifiers[id]).ForEach([&](olc::Key k) { keyIndex[k].push_back(id); });
+		}
+		ExactModifiersChanged = true;
+	}
+
+	const KeySet& olcPGEX_KeyComboManager::GetConsumedKeys() const {
+		return ConsumedKeys;
+	}
+
+	bool olcPGEX_KeyComboManager::IsKeyConsumed(olc::Key k) const {
+		return ConsumedKeys.Test(k);
+	}
+
+	HWButton olcPGEX_KeyComboManager::GetKey(olc::Key k) const {
+		HWButton state;
+		if (!ConsumedKeys.Test(k)) {
+			state.bPressed = Keyboard.Pressed.Test(k);
+			state.bReleased = Keyboard.Released.Test(k);
+			state.bHeld = Keyboard.Held.Test(k);
+		}
+		return state;
+	}
+
+	void olcPGEX_KeyComboManager::UpdateActiveLayers() {
+		std::fill(LayerActive.begin(), LayerActive.end(), uint8_t(0));
+		for (size_t i = LayerStack.back().Base; i < LayerStack.size(); i++) {
+			LayerActive[LayerStack[i].Layer] = 1;
+		}
+	}
+
+	KeyComboHandle olcPGEX_KeyComboManager::GetKeyComboHandle(size_t index) const {
+		if (index >= FirstRegistrations.size() || FirstRegistrations[index] == UINT32_MAX) {
+			return {};
+		}
+		uint32_t r = FirstRegistrations[index];
+		return { r, Generations[r] };
+	}
+
+	void olcPGEX_KeyComboManager::SetKeyComboCallback(KeyComboHandle handle, KeyComboCallback callback, uint8_t triggers) {
+		if (!IsValid(handle)) {
+			return;
+		}
+
+		size_t r = handle.Index;
+		if (!callback) {
+			triggers = 0;
+		}
+
+		//Keep the list of held callbacks in step when the triggers of a held combo change
+		RemoveSlot(HeldCallbacks, r);
+		if ((triggers & TriggerHeld) && Held.Test(RegistrationSlots[r])) {
+			HeldCallbacks.push_back(r);
+		}
+
+		Callbacks[r] = std::move(callback);
+		CallbackTriggers[r] = triggers;
+	}
+
+	size_t olcPGEX_KeyComboManager::RegisterKeySequence(const KeySequenceDefinition& def) {
+		size_t id = SequenceCount++;
+		SequencesCompleted.Resize(SequenceCount);
+
+		//Walk down the trie, adding nodes for any steps not shared with another sequence
+		uint32_t node = 0;
+		for (size_t i = 0; i < def.Steps.size(); i++) {
+			auto& step = def.Steps[i];
+			float timeout = (i > 0 && i < def.Timeouts.size()) ? def.Timeouts[i] : 0.0f;
+
+			auto& children = SequenceEdges[(uint64_t(node) << 32) | step.Key];
+			auto child = std::find_if(children.begin(), children.end(), [&](uint32_t c) {
+				return SequenceNodes[c].Modifiers == step.Modifiers && SequenceNodes[c].Timeout == timeout;
+			});
+
+			if (child != children.end()) {
+				node = *child;
+			}
+			else {
+				uint32_t next = uint32_t(SequenceNodes.size());
+				SequenceNodes.push_back({ step.Modifiers, timeout, 0.0f, {} });
+
+				//A node only runs out of time if every child has a limit
+				auto& parent = SequenceNodes[node];
+				if (parent.ChildCount == 0) {
+					parent.Window = timeout;
+				}
+				else if (parent.Window > 0.0f) {
+					parent.Window = timeout > 0.0f ? std::max(parent.Window, timeout) : 0.0f;
+				}
+				parent.ChildCount++;
+
+				SequenceReached.push_back(-1.0);
+				SequenceStamp.push_back(0);
+				SequenceSlot.push_back(0);
+				children.push_back(next);
+				node = next;
+			}
+
+			SequenceModifierKeys = SequenceModifierKeys | step.Modifiers;
+		}
+
+		if (node != 0) {
+			SequenceNodes[node].Completes.push_back(id);
+		}
+
+		return id;
+	}
+
+	bool olcPGEX_KeyComboManager::GetKeySequence(size_t id) const {
+		return SequencesCompleted.Test(id);
+	}
+
+	const ComboSet& olcPGEX_KeyComboManager::GetCompletedKeySequences() const {
+		return SequencesCompleted;
+	}
+
+	void olcPGEX_KeyComboManager::UpdateKeySequences() {
+		for (auto id : SequencesCompletedList) {
+			SequencesCompleted.Set(id, false);
+		}
+		SequencesCompletedList.clear();
+
+		if (SequenceNodes.size() == 1) {
+			return;
+		}
+
+		//Drop the partial matches which ran out of time.  Deadlines of matches which
+		//have since advanced or been abandoned no longer match the node and are skipped.
+		while (!SequenceDeadlines.empty() && SequenceDeadlines.top().Deadline < Clock) {
+			auto expired = SequenceDeadlines.top();
+			SequenceDeadlines.pop();
+			if (SequenceReached[expired.Node] == expired.Reached) {
+				SequenceReached[expired.Node] = -1.0;
+			}
+		}
+
+		Keyboard.Pressed.ForEach([&](olc::Key k) {
+			SequenceNext.clear();
+			SequenceNextReached.clear();
+			SequenceFrame++;
+
+			//Only nodes with children can be advanced further.  A node added twice keeps
+			//the latest time it was reached, which leaves it the most time for the next step.
+			auto add = [&](uint32_t node, double reached) {
+				if (SequenceNodes[node].ChildCount == 0) return;
+
+				if (SequenceStamp[node] != SequenceFrame) {
+					SequenceStamp[node] = SequenceFrame;
+					SequenceSlot[node] = uint32_t(SequenceNext.size());
+					SequenceNext.push_back(node);
+					SequenceNextReached.push_back(reached);
+				}
+				else {
+					auto& r = SequenceNextReached[SequenceSlot[node]];
+					r = std::max(r, reached);
+				}
+			};
+
+			auto advance = [&](uint32_t node) {
+				auto edge = SequenceEdges.find((uint64_t(node) << 32) | k);
+				if (edge == SequenceEdges.end()) return;
+
+				for (auto child : edge->second) {
+					auto& c = SequenceNodes[child];
+					if (!Keyboard.Held.Contains(c.Modifiers)) continue;
+					if (node != 0 && c.Timeout > 0.0f && SequenceReached[node] + c.Timeout < Clock) continue;
+
+					add(child, Clock);
+					for (auto id : c.Completes) {
+						if (!SequencesCompleted.Test(id)) {
+							SequencesCompleted.Set(id);
+							SequencesCompletedList.push_back(id);
+						}
+					}
+				}
+			};
+
+			//Every partial match, plus the root since any sequence may start now
+			advance(0);
+			for (auto node : SequenceActive) {
+				if (SequenceReached[node] < 0.0) continue;
+
+				advance(node);
+
+				//Modifier keys may be pressed between steps without losing the match
+				if (SequenceModifierKeys.Test(k)) {
+					add(node, SequenceReached[node]);
+				}
+			}
+
+			for (auto node : SequenceActive) {
+				SequenceReached[node] = -1.0;
+			}
+
+			for (size_t i = 0; i < SequenceNext.size(); i++) {
+				uint32_t node = SequenceNext[i];
+				double reached = SequenceNextReached[i];
+				SequenceReached[node] = reached;
+
+				//Matches which were kept already have a deadline
+				if (reached == Clock && SequenceNodes[node].Window > 0.0f) {
+					SequenceDeadlines.push({ reached + SequenceNodes[node].Window, reached, node });
+				}
+			}
+
+			std::swap(SequenceActive, SequenceNext);
+		});
+	}
+
+	size_t olcPGEX_KeyComboManager::RegisterKeyChord(const KeyChordDefinition def) {
+		size_t id = ChordKeys.size();
+		ChordKeys.push_back(def.Keys);
+		ChordWindows.push_back(def.Window);
+
+		ChordHeld.Resize(id + 1);
+		ChordPressed.Resize(id + 1);
+		ChordReleased.Resize(id + 1);
+
+		def.Keys.ForEach([&](olc::Key k) { ChordIndex[k].push_back(id); });
+
+		return id;
+	}
+
+	HWButton olcPGEX_KeyComboManager::GetKeyChord(size_t id) const {
+		HWButton state;
+		state.bPressed = ChordPressed.Test(id);
+		state.bReleased = ChordReleased.Test(id);
+		state.bHeld = ChordHeld.Test(id);
+		return state;
+	}
+
+	void olcPGEX_KeyComboManager::UpdateKeyChords(const KeySet& changed) {
+		for (auto id : ChordPending) {
+			ChordPressed.Set(id, false);
+			ChordReleased.Set(id, false);
+		}
+		ChordPending.clear();
+
+		changed.ForEach([&](olc::Key k) {
+			for (auto id : ChordIndex[k]) {
+				bool held = ChordHeld.Test(id);
+
+				if (held && !Keyboard.Held.Contains(ChordKeys[id])) {
+					ChordHeld.Set(id, false);
+					ChordReleased.Set(id);
+					ChordPending.push_back(id);
+				}
+				else if (!held && Keyboard.Pressed.Test(k) && Keyboard.Held.Contains(ChordKeys[id])) {
+					//Every key is down and k was the last, check the first was recent enough
+					double first = Clock;
+					ChordKeys[id].ForEach([&](olc::Key c) { first = std::min(first, KeyPressedTime[c]); });
+
+					if (Clock - first <= ChordWindows[id]) {
+						ChordHeld.Set(id);
+						ChordPressed.Set(id);
+						ChordPending.push_back(id);
+					}
+				}
+			}
+		});
+	}
+
+	HWButton olcPGEX_KeyComboManager::GetKeyCombo(KeyComboHandle handle) const {
+		if (!IsValid(handle)) {
+			return {};
+		}
+		return GetKeyCombo(int(RegistrationSlots[handle.Index]));
+	}
+
+	HWButton olcPGEX_KeyComboManager::GetKeyCombo(const int i) const {
+		HWButton state;
+		state.bPressed = Pressed.Test(i);
+		state.bReleased = Released.Test(i);
+		state.bHeld = Held.Test(i);
+		return state;
+	}
+
+	const ComboSet& olcPGEX_KeyComboManager::GetPressedKeyCombos() const {
+		return Pressed;
+	}
+
+	const ComboSet& olcPGEX_KeyComboManager::GetHeldKeyCombos() const {
+		return Held;
+	}
+
+	const ComboSet& olcPGEX_KeyComboManager::GetReleasedKeyCombos() const {
+		return Released;
+	}
+
+	const std::vector<KeyComboEvent>& olcPGEX_KeyComboManager::GetKeyComboEvents() const {
+		return Events;
+	}
+
+	void olcPGEX_KeyComboManager::DispatchCallbacks() {
+		//A callback may unregister combos, which clears their triggers but leaves these
+		//lists alone until every callback has run
+		Dispatching = true;
+
+		//Pressed and Released edges, unless the combo is held and will be called below
+		for (size_t n = 0; n < Events.size(); n++) {
+			const KeyComboEvent& e = Events[n];
+			size_t r = e.Handle.Index;
+			uint8_t triggers = CallbackTriggers[r];
+			if (!triggers) continue;
+
+			if (e.Transition == KeyComboTransition::Pressed && (triggers & TriggerHeld)) {
+				HeldCallbacks.push_back(r);
+			}
+			else if (e.Transition == KeyComboTransition::Released && (triggers & TriggerHeld)) {
+				RemoveSlot(HeldCallbacks, r);
+			}
+
+			size_t id = RegistrationSlots[r];
+			uint8_t trigger = e.Transition == KeyComboTransition::Pressed ? TriggerPressed : TriggerReleased;
+			if ((triggers & trigger) && !((triggers & TriggerHeld) && Held.Test(id))) {
+				Callbacks[r](e.Handle, GetKeyCombo(int(id)));
+			}
+		}
+
+		for (size_t n = 0; n < HeldCallbacks.size(); n++) {
+			size_t r = HeldCallbacks[n];
+			if (CallbackTriggers[r] & TriggerHeld) {
+				Callbacks[r]({ uint32_t(r), Generations[r] }, GetKeyCombo(int(RegistrationSlots[r])));
+			}
+		}
+		Dispatching = false;
+
+		if (!RetiredRegistrations.empty()) {
+			HeldCallbacks.erase(std::remove_if(HeldCallbacks.begin(), HeldCallbacks.end(),
+				[&](size_t r) { return !(CallbackTriggers[r] & TriggerHeld); }), HeldCallbacks.end());
+			for (auto r : RetiredRegistrations) {
+				Callbacks[r] = {};
+				FreeRegistrations.push_back(r);
+			}
+			RetiredRegistrations.clear();
+		}
+	}
+
+	void olcPGEX_KeyComboManager::SetUpdateMode(UpdateMode mode) {
+		Mode = mode;
+	}
+
+	//Run the combo state machine on count words of 64 combos each
+	static void UpdateComboStateWords(const uint64_t* mods_held, const uint64_t* key_pressed, const uint64_t* key_held,
+		uint64_t* held, uint64_t* pressed, uint64_t* released, size_t count) {
+		size_t i = 0;
+#if defined(OLC_PGEX_KEY_COMBO_AVX2)
+		for (; i + 4 <= count; i += 4) {
+			__m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mods_held + i));
+			__m256i kp = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(key_pressed + i));
+			__m256i kh = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(key_held + i));
+			__m256i old = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(held + i));
+			__m256i state = _mm256_and_si256(m, _mm256_or_si256(kp, _mm256_and_si256(old, kh)));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(pressed + i), _mm256_andnot_si256(old, state));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(released + i), _mm256_andnot_si256(state, old));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(held + i), state);
+		}
+#elif defined(OLC_PGEX_KEY_COMBO_SSE2)
+		for (; i + 2 <= count; i += 2) {
+			__m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mods_held + i));
+			__m128i kp = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key_pressed + i));
+			__m128i kh = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key_held + i));
+			__m128i old = _mm_loadu_si128(reinterpret_cast<const __m128i*>(held + i));
+			__m128i state = _mm_and_si128(m, _mm_or_si128(kp, _mm_and_si128(old, kh)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pressed + i), _mm_andnot_si128(old, state));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(released + i), _mm_andnot_si128(state, old));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(held + i), state);
+		}
+#endif
+		//Same logic as UpdateKeyCombo, for 64 combos at a time
+		for (; i < count; i++) {
+			uint64_t state = mods_held[i] & (key_pressed[i] | (held[i] & key_held[i]));
+			pressed[i] = state & ~held[i];
+			released[i] = held[i] & ~state;
+			held[i] = state;
+		}
+	}
+
+	void olcPGEX_KeyComboManager::UpdateAllKeyCombos() {
+		//The state sets may hold more words than the slots need, so the scratch sets
+		//are sized from them rather than from the slot count
+		size_t count = ComboKeys.size();
+		size_t words = Held.Words.size();
+		BatchModsHeld.Resize(words * 64);
+		BatchKeyPressed.Resize(words * 64);
+		BatchKeyHeld.Resize(words * 64);
+
+		//Gather the inputs of every combo into bitsets
+		for (size_t w = 0; w < words; w++) {
+			uint64_t mods_held = 0;
+			uint64_t key_pressed = 0;
+			uint64_t key_held = 0;
+			size_t end = std::min(count, (w + 1) * 64);
+			for (size_t i = w * 64; i < end; i++) {
+				mods_held |= uint64_t(LayerActive[ComboLayers[i]] && (Keyboard.Held & ComboMasks[i]) == ComboModifiers[i]) << (i % 64);
+				key_pressed |= uint64_t(Keyboard.Pressed.Test(ComboKeys[i])) << (i % 64);
+				key_held |= uint64_t(Keyboard.Held.Test(ComboKeys[i])) << (i % 64);
+			}
+			BatchModsHeld.Words[w] = mods_held;
+			BatchKeyPressed.Words[w] = key_pressed;
+			BatchKeyHeld.Words[w] = key_held;
+		}
+
+		UpdateComboStateWords(BatchModsHeld.Words.data(), BatchKeyPressed.Words.data(), BatchKeyHeld.Words.data(),
+			Held.Words.data(), Pressed.Words.data(), Released.Words.data(), words);
+
+		//Remember which combos need their Pressed or Released flag cleared next frame
+		for (size_t w = 0; w < words; w++) {
+			for (uint64_t bits = Pressed.Words[w] | Released.Words[w]; bits; bits &= bits - 1) {
+				PendingCombos.push_back(w * 64 + CountTrailingZeros(bits));
+			}
+		}
+	}
+
+	void olcPGEX_KeyComboManager::QueueKeyCombo(size_t i) {
+		if (!Queued.Test(i)) {
+			Queued.Set(i);
+			DirtyCombos.push_back(i);
+		}
+	}
+
+	void olcPGEX_KeyComboManager::UpdateKeyCombo(size_t i) {
+		//A combo in an inactive layer behaves as if its modifiers were released
+		bool mods_held = LayerActive[ComboLayers[i]] && (Keyboard.Held & ComboMasks[i]) == ComboModifiers[i];
+		bool held = Held.Test(i);
+
+		//The combo will become active if all the modifiers are held down and the Key is Pressed
+		//or all the modifiers are held down the the combo is already held
+		bool state = mods_held && (Keyboard.Pressed.Test(ComboKeys[i]) ||
+			(held && Keyboard.Held.Test(ComboKeys[i])));
+
+		//This is just the same logic as in PGE today for normal key presses.
+		Pressed.Set(i, state && !held);
+		Released.Set(i, !state && held);
+		Held.Set(i, state);
+	}
+
+	void olcPGEX_KeyComboManager::OnBeforeUserUpdate(float& fElapsedTime) {
+		Update(Source ? Source->Read() : ReadKeyboardState(pge), fElapsedTime);
+	}
+
+	void olcPGEX_KeyComboManager::Simulate(const KeyboardState* frames, size_t count, KeyComboSimulation& result, float fElapsedTime) {
+		result.FrameStart.reserve(result.FrameStart.size() + count);
+		for (size_t f = 0; f < count; f++) {
+			Update(frames[f], fElapsedTime);
+			result.Events.insert(result.Events.end(), Events.begin(), Events.end());
+			result.FrameStart.push_back(result.Events.size());
+		}
+	}
+
+	void olcPGEX_KeyComboManager::Simulate(const KeySet* held, size_t count, KeyComboSimulation& result, float fElapsedTime) {
+		result.FrameStart.reserve(result.FrameStart.size() + count);
+		KeyboardState frame;
+		for (size_t f = 0; f < count; f++) {
+			frame.Pressed = held[f].Without(Keyboard.Held);
+			frame.Released = Keyboard.Held.Without(held[f]);
+			frame.Held = held[f];
+			Update(frame, fElapsedTime);
+			result.Events.insert(result.Events.end(), Events.begin(), Events.end());
+			result.FrameStart.push_back(result.Events.size());
+		}
+	}
+
+	void olcPGEX_KeyComboManager::Update(const KeyboardState& keyboard, float fElapsedTime) {
+		Keyboard = keyboard;
+
+		KeySet changed = Keyboard.Pressed | Keyboard.Released;
+
+		Clock += fElapsedTime;
+		Keyboard.Pressed.ForEach([&](olc::Key k) { KeyPressedTime[k] = Clock; });
+
+		if (LayersChanged) {
+			UpdateActiveLayers();
+		}
+
+		bool batch = Mode == UpdateMode::Batch;
+		if (Mode == UpdateMode::Auto) {
+			//Once a good share of the combos need evaluating, queueing them one by one
+			//costs more than running the batch update over all of them
+			size_t work = PendingCombos.size();
+			if (LayersChanged || ExactModifiersChanged) {
+				work += Held.Count();
+			}
+			for (size_t l = LayerStack.back().Base; l < LayerStack.size(); l++) {
+				const auto& keyIndex = KeyIndex[LayerStack[l].Layer];
+				changed.ForEach([&](olc::Key k) { work += keyIndex[k].size(); });
+			}
+			batch = work * 4 > ComboKeys.size();
+		}
+
+		if (batch) {
+			PendingCombos.clear();
+			UpdateAllKeyCombos();
+		}
+		else {
+			UpdateQueuedKeyCombos(changed);
+		}
+		LayersChanged = false;
+		ExactModifiersChanged = false;
+
+		if (Shadowing) {
+			ResolveShadowing();
+		}
+
+		//Every combo which was Pressed or Released this frame is pending, in ascending order.
+		//Each registration of the combo gets its own event.
+		Events.clear();
+		KeySet releasedKeys;
+		for (auto i : PendingCombos) {
+			olc::Key key = ComboKeys[i];
+			KeyComboTransition transition = KeyComboTransition::Pressed;
+			if (Pressed.Test(i)) {
+				if (HeldKeyCombos[key]++ == 0) HeldComboKeys.Set(key);
+			}
+			else {
+				transition = KeyComboTransition::Released;
+				if (--HeldKeyCombos[key] == 0) HeldComboKeys.Set(key, false);
+				releasedKeys.Set(key);
+			}
+			for (uint32_t r = FirstRegistrations[i]; r != UINT32_MAX; r = NextRegistrations[r]) {
+				Events.push_back({ { r, Generations[r] }, transition });
+			}
+		}
+		ConsumedKeys = HeldComboKeys | releasedKeys;
+
+		if (Recorder) {
+			Recorder->RecordFrame(Keyboard, fElapsedTime, Events);
+		}
+
+		UpdateKeySequences();
+		UpdateKeyChords(changed);
+
+		DispatchCallbacks();
+	}
+
+	void olcPGEX_KeyComboManager::UpdateQueuedKeyCombos(const KeySet& changed) {
+		DirtyCombos.clear();
+
+		//Combos which were Pressed or Released last frame need those flags cleared
+		for (auto i : PendingCombos) {
+			QueueKeyCombo(i);
+		}
+		PendingCombos.clear();
+
+		//Held combos in a layer which was just deactivated must be Released, as must
+		//Exact combos if an exact modifier they do not use is now held
+		if (LayersChanged || ExactModifiersChanged) {
+			for (auto i : Held) {
+				if (!LayerActive[ComboLayers[i]] || (ExactModifiersChanged && ComboExact[i])) {
+					QueueKeyCombo(i);
+				}
+			}
+		}
+
+		//A combo can only change state if one of its keys changed state, and only
+		//the combos in active layers are looked at
+		for (size_t l = LayerStack.back().Base; l < LayerStack.size(); l++) {
+			const auto& keyIndex = KeyIndex[LayerStack[l].Layer];
+			changed.ForEach([&](olc::Key k) {
+				for (auto i : keyIndex[k]) {
+					QueueKeyCombo(i);
+				}
+			});
+		}
+
+		//Evaluate in ascending order so the pending list, and the events, are sorted
+		std::sort(DirtyCombos.begin(), DirtyCombos.end());
+		for (auto i : DirtyCombos) {
+			Queued.Set(i, false);
+			UpdateKeyCombo(i);
+
+			if (Pressed.Test(i) || Released.Test(i)) {
+				PendingCombos.push_back(i);
+			}
+		}
+	}
+
+	//Append v as a little endian base 128 varint
+	static void AppendVarint(std::vector<uint8_t>& out, uint64_t v) {
+		while (v >= 0x80) {
+			out.push_back(uint8_t(v) | 0x80);
+			v >>= 7;
+		}
+		out.push_back(uint8_t(v));
+	}
+
+	KeyComboRecorder::~KeyComboRecorder() {
+		Close();
+	}
+
+	bool KeyComboRecorder::Open(const std::string& path) {
+		Close();
+
+		File.open(path, std::ios::binary | std::ios::trunc);
+		if (!File) {
+			return false;
+		}
+
+		Previous = {};
+		PreviousElapsed = 0;
+		Stopping = false;
+		Block.clear();
+		Block.reserve(BlockSize + 1024);
+		Block.insert(Block.end(), { 'O', 'K', 'C', 'L', 1 });
+		AppendVarint(Block, olc::Key::ENUM_END);
+
+		Writer = std::thread(&KeyComboRecorder::WriteBlocks, this);
+		return true;
+	}
+
+	void KeyComboRecorder::Close() {
+		if (!Writer.joinable()) {
+			return;
+		}
+
+		Submit();
+		{
+			std::lock_guard<std::mutex> guard(Lock);
+			Stopping = true;
+		}
+		Wake.notify_one();
+		Writer.join();
+		File.close();
+	}
+
+	bool KeyComboRecorder::IsOpen() const {
+		return Writer.joinable();
+	}
+
+	void KeyComboRecorder::RecordFrame(const KeyboardState& keyboard, float fElapsedTime, const std::vector<KeyComboEvent>& events) {
+		if (!IsOpen()) {
+			return;
+		}
+
+		uint32_t elapsed;
+		std::memcpy(&elapsed, &fElapsedTime, sizeof(elapsed));
+
+		KeySet changed;
+		for (size_t w = 0; w < KeySet::WordCount; w++) {
+			changed.Words[w] = (keyboard.Held.Words[w] ^ Previous.Held.Words[w]) |
+				(keyboard.Pressed.Words[w] ^ Previous.Pressed.Words[w]) |
+				(keyboard.Released.Words[w] ^ Previous.Released.Words[w]);
+		}
+		bool keysChanged = changed.Any();
+
+		uint8_t flags = uint8_t((elapsed != PreviousElapsed ? 1 : 0) | (keysChanged ? 2 : 0) | (events.empty() ? 0 : 4));
+		Block.push_back(flags);
+
+		if (flags & 1) {
+			for (int i = 0; i < 4; i++) Block.push_back(uint8_t(elapsed >> (i * 8)));
+			PreviousElapsed = elapsed;
+		}
+
+		if (keysChanged) {
+			size_t count = 0;
+			changed.ForEach([&](olc::Key) { count++; });
+			AppendVarint(Block, count);
+			changed.ForEach([&](olc::Key k) {
+				uint64_t state = (keyboard.Pressed.Test(k) ? 4 : 0) | (keyboard.Released.Test(k) ? 2 : 0) | (keyboard.Held.Test(k) ? 1 : 0);
+				AppendVarint(Block, (uint64_t(k) << 3) | state);
+			});
+			Previous = keyboard;
+		}
+
+		if (!events.empty()) {
+			AppendVarint(Block, events.size());
+			for (auto& e : events) {
+				AppendVarint(Block, (uint64_t(e.Handle.Index) << 1) | (e.Transition == KeyComboTransition::Released ? 1 : 0));
+			}
+		}
+
+		if (Block.size() >= BlockSize) {
+			Submit();
+		}
+	}
+
+	void KeyComboRecorder::Submit() {
+		if (Block.empty()) {
+			return;
+		}
+
+		std::vector<uint8_t> next;
+		next.reserve(BlockSize + 1024);
+		{
+			std::lock_guard<std::mutex> guard(Lock);
+			Blocks.push_back(std::move(Block));
+		}
+		Block = std::move(next);
+		Wake.notify_one();
+	}
+
+	void KeyComboRecorder::WriteBlocks() {
+		std::vector<std::vector<uint8_t>> writing;
+		for (;;) {
+			bool stopping;
+			{
+				std::unique_lock<std::mutex> guard(Lock);
+				Wake.wait(guard, [&] { return Stopping || !Blocks.empty(); });
+				writing.swap(Blocks);
+				stopping = Stopping;
+			}
+
+			for (auto& block : writing) {
+				File.write(reinterpret_cast<const char*>(block.data()), std::streamsize(block.size()));
+			}
+			writing.clear();
+
+			if (stopping) {
+				File.flush();
+				return;
+			}
+		}
+	}
+
+	ReplayKeyboardSource::~ReplayKeyboardSource() {
+		Close();
+	}
+
+	bool ReplayKeyboardSource::Open(const std::string& path) {
+		Close();
+
+#if defined(_WIN32)
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER size;
+		HANDLE mapping = nullptr;
+		void* view = nullptr;
+		if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+			mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mapping) {
+				view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			}
+		}
+		if (!view) {
+			if (mapping) CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+		FileHandle = file;
+		MappingHandle = mapping;
+		Mapping = view;
+		MappingSize = size_t(size.QuadPart);
+#else
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+		struct stat info;
+		void* view = MAP_FAILED;
+		if (fstat(fd, &info) == 0 && info.st_size > 0) {
+			view = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		}
+		//The mapping stays valid after the descriptor is closed
+		close(fd);
+		if (view == MAP_FAILED) {
+			return false;
+		}
+		Mapping = view;
+		MappingSize = size_t(info.st_size);
+#endif
+
+		if (!Open(static_cast<const uint8_t*>(Mapping), MappingSize)) {
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	bool ReplayKeyboardSource::Open(const uint8_t* data, size_t size) {
+		Data = data;
+		Size = size;
+		Position = 0;
+		Current = {};
+		Elapsed = 0;
+		Frame = 0;
+		FirstMismatch = SIZE_MAX;
+		EventsPosition = SIZE_MAX;
+
+		//A log from a build with a different number of keys cannot be replayed
+		uint64_t keys;
+		Position = 5;
+		if (Size < 5 || std::memcmp(Data, "OKCL", 4) != 0 || Data[4] != 1 ||
+			!ReadVarint(Position, keys) || keys != uint64_t(olc::Key::ENUM_END)) {
+			Data = nullptr;
+			Size = 0;
+			Position = 0;
+			return false;
+		}
+		return true;
+	}
+
+	void ReplayKeyboardSource::Close() {
+		if (Mapping) {
+#if defined(_WIN32)
+			UnmapViewOfFile(Mapping);
+			CloseHandle(MappingHandle);
+			CloseHandle(FileHandle);
+			MappingHandle = nullptr;
+			FileHandle = nullptr;
+#else
+			munmap(Mapping, MappingSize);
+#endif
+			Mapping = nullptr;
+			MappingSize = 0;
+		}
+		Data = nullptr;
+		Size = 0;
+		Position = 0;
+	}
+
+	bool ReplayKeyboardSource::AtEnd() const {
+		return Position >= Size;
+	}
+
+	float ReplayKeyboardSource::NextElapsedTime() const {
+		uint32_t elapsed = Elapsed;
+		if (Position + 5 <= Size && (Data[Position] & 1)) {
+			elapsed = 0;
+			for (int i = 0; i < 4; i++) elapsed |= uint32_t(Data[Position + 1 + i]) << (i * 8);
+		}
+		float fElapsedTime;
+		std::memcpy(&fElapsedTime, &elapsed, sizeof(fElapsedTime));
+		return fElapsedTime;
+	}
+
+	size_t ReplayKeyboardSource::GetFrame() const {
+		return Frame;
+	}
+
+	size_t ReplayKeyboardSource::GetFirstMismatch() const {
+		return FirstMismatch;
+	}
+
+	bool ReplayKeyboardSource::ReadVarint(size_t& pos, uint64_t& v) const {
+		v = 0;
+		for (int shift = 0; pos < Size && shift < 64; shift += 7) {
+			uint8_t byte = Data[pos++];
+			v |= uint64_t(byte & 0x7F) << shift;
+			if (!(byte & 0x80)) return true;
+		}
+		return false;
+	}
+
+	void ReplayKeyboardSource::Truncated() {
+		Position = Size;
+		EventsPosition = SIZE_MAX;
+	}
+
+	KeyboardState ReplayKeyboardSource::Read() {
+		//Past the end, or on a damaged frame, keys stay held with nothing Pressed or Released
+		KeyboardState idle;
+		idle.Held = Current.Held;
+		EventsPosition = SIZE_MAX;
+		if (AtEnd()) {
+			return idle;
+		}
+
+		uint8_t flags = Data[Position++];
+		if (flags & 1) {
+			if (Position + 4 > Size) {
+				Truncated();
+				return idle;
+			}
+			Elapsed = 0;
+			for (int i = 0; i < 4; i++) Elapsed |= uint32_t(Data[Position++]) << (i * 8);
+		}
+
+		if (flags & 2) {
+			uint64_t count;
+			if (!ReadVarint(Position, count)) {
+				Truncated();
+				return idle;
+			}
+			for (uint64_t n = 0; n < count; n++) {
+				uint64_t v;
+				if (!ReadVarint(Position, v) || (v >> 3) >= uint64_t(olc::Key::ENUM_END)) {
+					Truncated();
+					return idle;
+				}
+				olc::Key k = olc::Key(v >> 3);
+				Current.Pressed.Set(k, v & 4);
+				Current.Released.Set(k, v & 2);
+				Current.Held.Set(k, v & 1);
+			}
+		}
+
+		//Leave the transitions in the mapping, VerifyEvents decodes them in place
+		if (flags & 4) {
+			EventsPosition = Position;
+			uint64_t count, v;
+			bool ok = ReadVarint(Position, count);
+			for (uint64_t n = 0; ok && n < count; n++) {
+				ok = ReadVarint(Position, v);
+			}
+			if (!ok) {
+				Truncated();
+				return idle;
+			}
+		}
+
+		Frame++;
+		return Current;
+	}
+
+	bool ReplayKeyboardSource::VerifyEvents(const std::vector<KeyComboEvent>& events) const {
+		if (EventsPosition == SIZE_MAX) {
+			return events.empty();
+		}
+
+		size_t pos = EventsPosition;
+		uint64_t count;
+		ReadVarint(pos, count);
+		if (count != events.size()) {
+			return false;
+		}
+		for (auto& e : events) {
+			uint64_t v;
+			ReadVarint(pos, v);
+			if (v != ((uint64_t(e.Handle.Index) << 1) | (e.Transition == KeyComboTransition::Released ? 1 : 0))) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	size_t ReplayKeyboardSource::ReplayInto(olcPGEX_KeyComboManager& manager) {
+		manager.SetKeyboardSource(this);
+
+		size_t mismatches = 0;
+		while (!AtEnd()) {
+			size_t frame = Frame;
+			float fElapsedTime = NextElapsedTime();
+			manager.OnBeforeUserUpdate(fElapsedTime);
+			if (!VerifyEvents(manager.GetKeyComboEvents())) {
+				if (FirstMismatch == SIZE_MAX) FirstMismatch = frame;
+				mismatches++;
+			}
+		}
+		return mismatches;
+	}
+
+#ifdef OLC_PGEX_KEY_COMBO_BENCHMARK
+	KeyComboBenchmarkResult RunKeyComboBenchmark(const KeyComboBenchmarkParams& params) {
+		//Keys are drawn from the letters, digits and function keys, modifiers from a
+		//separate set of keys
+		static constexpr olc::Key modifierPool[] = { olc::Key::SHIFT, olc::Key::CTRL, olc::Key::TAB, olc::Key::SPACE,
+			olc::Key::INS, olc::Key::DEL, olc::Key::HOME, olc::Key::END, olc::Key::PGUP, olc::Key::PGDN,
+			olc::Key::BACK, olc::Key::CAPS_LOCK };
+		static constexpr int modifierPoolSize = int(sizeof(modifierPool) / sizeof(modifierPool[0]));
+		auto randomKey = [](std::mt19937& rng) {
+			return olc::Key(olc::Key::A + rng() % (olc::Key::F12 - olc::Key::A + 1));
+		};
+
+		std::mt19937 rng(params.Seed);
+		int modifiers = std::min(std::max(params.Modifiers, 0), modifierPoolSize);
+
+		std::vector<KeyComboDefinition> defs;
+		defs.reserve(params.Combos);
+		for (size_t i = 0; i < params.Combos; i++) {
+			KeyComboDefinition def(randomKey(rng));
+			while (def.ModifierCount < modifiers) {
+				olc::Key k = modifierPool[rng() % modifierPoolSize];
+				if (!def.Modifiers.Test(k)) {
+					def.Modifiers.Set(k);
+					def.ModifierCount++;
+				}
+			}
+			defs.push_back(def);
+		}
+
+		//Build every frame before timing anything
+		ScriptedKeyboardSource script;
+		KeySet held;
+		olc::Key tapped = olc::Key::NONE;
+		for (size_t f = 0; f < params.Frames; f++) {
+			switch (params.Activity) {
+			case BenchmarkActivity::Idle:
+				break;
+			case BenchmarkActivity::Typing:
+				//A key tapped for 3 frames out of every 6, and a modifier changed now and then
+				if (f % 6 == 0) {
+					tapped = randomKey(rng);
+					held.Set(tapped);
+				}
+				else if (f % 6 == 3) {
+					held.Set(tapped, false);
+				}
+				if (rng() % 30 == 0) {
+					olc::Key k = modifierPool[rng() % modifierPoolSize];
+					held.Set(k, !held.Test(k));
+				}
+				break;
+			case BenchmarkActivity::Mashing:
+				for (int n = 0; n < 4; n++) {
+					olc::Key k = randomKey(rng);
+					held.Set(k, !held.Test(k));
+				}
+				if (rng() % 2 == 0) {
+					olc::Key k = modifierPool[rng() % modifierPoolSize];
+					held.Set(k, !held.Test(k));
+				}
+				break;
+			}
+			script.PushFrame(held);
+		}
+
+		olcPGEX_KeyComboManager manager(false);
+		manager.SetKeyboardSource(&script);
+		manager.SetUpdateMode(params.Mode);
+		auto handles = manager.RegisterKeyCombos(defs);
+
+		KeyComboBenchmarkResult result;
+		result.Params = params;
+		ComboSet slots;
+		slots.Resize(defs.size());
+		for (auto handle : handles) {
+			slots.Set(manager.GetKeyComboSlot(handle));
+		}
+		result.Slots = slots.Count();
+
+		float fElapsedTime = 1.0f / 60.0f;
+		auto start = std::chrono::steady_clock::now();
+		for (size_t f = 0; f < params.Frames; f++) {
+			manager.OnBeforeUserUpdate(fElapsedTime);
+			result.Events += manager.GetKeyComboEvents().size();
+		}
+		double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+		result.NsPerFrame = params.Frames ? ns / double(params.Frames) : 0.0;
+		result.NsPerCombo = result.Slots ? result.NsPerFrame / double(result.Slots) : 0.0;
+		return result;
+	}
+
+	void RunKeyComboBenchmarkSuite(std::ostream& out, UpdateMode mode) {
+		static constexpr size_t comboCounts[] = { 10, 100, 1000, 10000, 100000 };
+		static constexpr int modifierCounts[] = { 0, 1, 2, 4, 8 };
+		static constexpr BenchmarkActivity activities[] = { BenchmarkActivity::Idle, BenchmarkActivity::Typing, BenchmarkActivity::Mashing };
+		static constexpr const char* activityNames[] = { "idle", "typing", "mashing" };
+
+		char line[128];
+		std::snprintf(line, sizeof(line), "%8s %6s %9s %8s %12s %12s %10s\n", "combos", "mods", "activity", "slots", "ns/frame", "ns/combo", "events");
+		out << line;
+
+		for (auto combos : comboCounts) {
+			for (auto modifiers : modifierCounts) {
+				for (auto activity : activities) {
+					KeyComboBenchmarkParams params;
+					params.Combos = combos;
+					params.Modifiers = modifiers;
+					params.Activity = activity;
+					params.Mode = mode;
+					auto result = RunKeyComboBenchmark(params);
+
+					std::snprintf(line, sizeof(line), "%8zu %6d %9s %8zu %12.1f %12.3f %10zu\n", combos, modifiers,
+						activityNames[int(activity)], result.Slots, result.NsPerFrame, result.NsPerCombo, result.Events);
+					out << line;
+				}
+			}
+		}
+	}
+#endif
+
+#ifdef OLC_PGEX_KEY_COMBO_SELF_TEST
+	size_t RunKeyComboSelfTest(std::ostream& out, uint32_t seed) {
+#if defined(OLC_PGEX_KEY_COMBO_AVX2)
+		const char* path = "AVX2";
+#elif defined(OLC_PGEX_KEY_COMBO_SSE2)
+		const char* path = "SSE2";
+#else
+		const char* path = "scalar";
+#endif
+		std::mt19937_64 rng(seed);
+		size_t failures = 0;
+		char line[128];
+
+		//The state machine on whole words, for every count up to a few SIMD widths
+		//so each vector loop and the scalar tail after it are covered
+		for (size_t count = 0; count <= 19; count++) {
+			for (int round = 0; round < 200; round++) {
+				std::vector<uint64_t> mods(count), kp(count), kh(count), held(count), pressed(count), released(count);
+				std::vector<uint64_t> refHeld(count), refPressed(count), refReleased(count);
+				for (size_t i = 0; i < count; i++) {
+					mods[i] = rng();
+					kp[i] = rng() & rng();
+					kh[i] = rng() | kp[i];
+					held[i] = refHeld[i] = rng();
+				}
+				UpdateComboStateWords(mods.data(), kp.data(), kh.data(), held.data(), pressed.data(), released.data(), count);
+
+				for (size_t i = 0; i < count; i++) {
+					uint64_t state = mods[i] & (kp[i] | (refHeld[i] & kh[i]));
+					refPressed[i] = state & ~refHeld[i];
+					refReleased[i] = refHeld[i] & ~state;
+					refHeld[i] = state;
+				}
+				if (held != refHeld || pressed != refPressed || released != refReleased) {
+					std::snprintf(line, sizeof(line), "%s state words differ from scalar, count %zu round %d\n", path, count, round);
+					out << line;
+					failures++;
+				}
+			}
+		}
+
+		//Whole managers on every update path, fed the same Key Combos and input.  Keys
+		//and modifiers come from one small pool so combos overlap and change state often.
+		static constexpr olc::Key pool[] = { olc::Key::A, olc::Key::B, olc::Key::C, olc::Key::D, olc::Key::E,
+			olc::Key::SHIFT, olc::Key::CTRL, olc::Key::TAB, olc::Key::SPACE };
+		static constexpr size_t poolSize = sizeof(pool) / sizeof(pool[0]);
+		static constexpr const char* modeNames[] = { "Auto", "Indexed", "Batch" };
+
+		auto sameSet = [](const ComboSet& a, const ComboSet& b) {
+			auto i = a.begin(), j = b.begin();
+			for (; i != a.end() && j != b.end(); ++i, ++j) {
+				if (*i != *j) return false;
+			}
+			return i == a.end() && j == b.end();
+		};
+
+		for (int round = 0; round < 8; round++) {
+			olcPGEX_KeyComboManager managers[3] = { olcPGEX_KeyComboManager(false), olcPGEX_KeyComboManager(false), olcPGEX_KeyComboManager(false) };
+			KeyComboLayer layers[3];
+			for (int m = 0; m < 3; m++) {
+				managers[m].SetUpdateMode(UpdateMode(m));
+				managers[m].SetShadowing(round % 2 == 1);
+				layers[1] = managers[m].CreateLayer("first");
+				layers[2] = managers[m].CreateLayer("second");
+			}
+
+			auto randomDefinition = [&]() {
+				KeyComboDefinition def(pool[rng() % poolSize], rng() % 4 == 0);
+				for (int n = int(rng() % 3); n > 0; n--) {
+					olc::Key k = pool[rng() % poolSize];
+					if (k != def.Key && !def.Modifiers.Test(k)) {
+						def.Modifiers.Set(k);
+						def.ModifierCount++;
+					}
+				}
+				return def;
+			};
+
+			std::vector<KeyComboHandle> handles;
+			auto registerRandom = [&]() {
+				KeyComboDefinition def = randomDefinition();
+				KeyComboLayer layer = layers[rng() % 3];
+				int priority = int(rng() % 3);
+				KeyComboHandle handle;
+				for (auto& manager : managers) {
+					handle = manager.RegisterKeyCombo(def, layer);
+					manager.SetKeyComboPriority(handle, priority);
+				}
+				handles.push_back(handle);
+			};
+
+			//Batches are registered with RegisterKeyCombos, and later batches repeat
+			//definitions from the one before so existing slots are reused
+			std::vector<KeyComboDefinition> batch;
+			KeyComboLayer batchLayer;
+			auto registerBatch = [&]() {
+				std::vector<KeyComboHandle> added;
+				for (auto& manager : managers) {
+					added = manager.RegisterKeyCombos(batch, batchLayer);
+				}
+				handles.insert(handles.end(), added.begin(), added.end());
+			};
+
+			size_t combos = 20 + size_t(rng() % 300);
+			for (size_t i = 0; i < combos; i++) {
+				if (rng() % 2 == 0) {
+					registerRandom();
+				}
+				else {
+					batch.push_back(randomDefinition());
+				}
+			}
+			batchLayer = layers[rng() % 3];
+			registerBatch();
+			registerBatch();
+
+			KeyboardState keyboard;
+			for (int frame = 0; frame < 2000; frame++) {
+				uint64_t r = rng();
+				if (r % 40 == 0) {
+					KeyComboLayer layer = layers[1 + rng() % 2];
+					bool exclusive = rng() % 2 == 0;
+					for (auto& manager : managers) manager.PushLayer(layer, exclusive);
+				}
+				else if (r % 40 == 1) {
+					for (auto& manager : managers) manager.PopLayer();
+				}
+				else if (r % 40 == 2 && !handles.empty()) {
+					size_t n = rng() % handles.size();
+					for (auto& manager : managers) manager.UnregisterKeyCombo(handles[n]);
+					handles[n] = handles.back();
+					handles.pop_back();
+				}
+				else if (r % 40 == 3) {
+					registerRandom();
+				}
+				else if (r % 80 == 5) {
+					std::shuffle(batch.begin(), batch.end(), rng);
+					batch.erase(batch.begin() + batch.size() / 2, batch.end());
+					for (size_t n = rng() % 40; n > 0; n--) {
+						batch.push_back(randomDefinition());
+					}
+					registerBatch();
+				}
+				else if (r % 400 == 4) {
+					KeySet exact = MakeKeySet({ pool[rng() % poolSize], pool[rng() % poolSize] });
+					for (auto& manager : managers) manager.SetExactModifiers(exact);
+				}
+
+				KeySet held = keyboard.Held;
+				for (int n = int(rng() % 3); n > 0; n--) {
+					olc::Key k = pool[rng() % poolSize];
+					held.Set(k, !held.Test(k));
+				}
+				keyboard.Pressed = held.Without(keyboard.Held);
+				keyboard.Released = keyboard.Held.Without(held);
+				keyboard.Held = held;
+				for (auto& manager : managers) manager.Update(keyboard, 1.0f / 60.0f);
+
+				//Indexed is the reference the other two are compared with
+				const auto& reference = managers[int(UpdateMode::Indexed)];
+				for (int m : { int(UpdateMode::Auto), int(UpdateMode::Batch) }) {
+					const auto& manager = managers[m];
+					const auto& events = manager.GetKeyComboEvents();
+					const auto& expected = reference.GetKeyComboEvents();
+					bool same = events.size() == expected.size() &&
+						sameSet(manager.GetPressedKeyCombos(), reference.GetPressedKeyCombos()) &&
+						sameSet(manager.GetHeldKeyCombos(), reference.GetHeldKeyCombos()) &&
+						sameSet(manager.GetReleasedKeyCombos(), reference.GetReleasedKeyCombos());
+					for (size_t i = 0; same && i < events.size(); i++) {
+						same = events[i].Handle == expected[i].Handle && events[i].Transition == expected[i].Transition;
+					}
+					if (!same) {
+						std::snprintf(line, sizeof(line), "%s %s differs from Indexed, round %d frame %d\n", path, modeNames[m], round, frame);
+						out << line;
+						failures++;
+					}
+				}
+			}
+		}
+
+		std::snprintf(line, sizeof(line), "%s self test: %zu differences\n", path, failures);
+		out << line;
+		return failures;
+	}
+#endif
 }
 #endif
 #endif
\ No newline at end of file